@@ -0,0 +1,561 @@
+//Throughput benchmark of every engine at every width the compiler was allowed to use.
+//For each engine it measures single next() calls, bulk fill(), conversion to uniform doubles and floats and,
+//for the 4 and 8 lane engines, bounded 32-bit integers and normal doubles, next to std::normal_distribution. parallel_fill() is measured on a buffer far larger than the caches
+//for 1, 2, 4... up to --threads threads, next to std::memset of the same buffer as the memory bandwidth. Every measurement is repeated and the fastest run is reported,
+//as bytes/s, ns per output and TSC cycles per output, one row per measurement in CSV (default) or JSON.
+//
+//Usage: benchmark [--json] [--cpu N] [--threads N] [--filter TEXT] [--min-time SECONDS] [--repetitions N]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined __x86_64__ || defined __i386__
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "bit_pool.h"
+#include "bounded.h"
+#include "interleaved.h"
+#include "normal.h"
+#include "parallel.h"
+#include "philox.h"
+#include "splitmix.h"
+#include "uniform.h"
+#include "xoroshiro128plus.h"
+#include "xoroshiro128plusplus.h"
+#include "xorshift128plus.h"
+#include "xorshift64.h"
+#include "xoshiro256plusplus.h"
+#include "xoshiro256ss.h"
+
+namespace {
+
+//Instruction set the engines were compiled for.
+const char* compiled_isa()
+{
+#if defined __AVX512F__
+    return "avx512";
+#elif defined __AVX2__
+    return "avx2";
+#elif defined __AVX__
+    return "avx";
+#elif defined SIMDRAND_NEON
+    return "neon";
+#else
+    return "x86-64";
+#endif
+}
+
+//Reads the time stamp counter, or on AArch64 the generic timer, which counts at a fixed frequency below the core clock.
+inline uint64_t ticks()
+{
+#if defined SIMDRAND_NEON
+    uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return value;
+#else
+    return __rdtsc();
+#endif
+}
+
+//Makes the compiler assume value is read and modified here, so the computation producing it cannot be removed
+//or hoisted. Unlike a memory clobber, this lets the engine state stay in registers.
+inline void keep(uint64_t& value) { asm volatile("" : "+r"(value)); }
+
+#if defined SIMDRAND_NEON
+template <typename T>
+inline void keep(T& value) { asm volatile("" : "+w"(value)); }
+#else
+template <typename T>
+inline void keep(T& value) { asm volatile("" : "+x"(value)); }
+#endif
+
+//Makes the compiler assume everything reachable from p is read here.
+inline void escape(const void* p) { asm volatile("" : : "r"(p) : "memory"); }
+
+//Scalar std::mt19937_64 with the engine interface, as the baseline.
+struct mt19937_64 {
+    explicit mt19937_64(splitmix::splitmix64 gen) noexcept
+        : m_engine(gen.next())
+    {
+    }
+
+    uint64_t next() noexcept { return m_engine(); }
+
+    void fill(uint64_t* dst, size_t n) noexcept { simdrand::fill(*this, dst, n); }
+
+private:
+    std::mt19937_64 m_engine;
+};
+
+struct options {
+    bool json = false;
+    int cpu = -1;
+    unsigned threads = std::max(1U, std::thread::hardware_concurrency());
+    std::string filter;
+    double min_time = 0.05;
+    int repetitions = 5;
+};
+
+struct result {
+    std::string engine;
+    std::string width;
+    std::string benchmark;
+    size_t output_bytes;
+    double ns_per_output;
+    double cycles_per_output;
+};
+
+class runner {
+public:
+    explicit runner(const options& opt)
+        : m_options(opt)
+    {
+    }
+
+    //Measures body(), which produces outputs outputs of output_bytes bytes each per call.
+    template <typename Body>
+    void run(const char* engine, const char* width, const char* benchmark, size_t outputs, size_t output_bytes, Body&& body)
+    {
+        const std::string name = std::string(engine) + "/" + width + "/" + benchmark;
+        if (name.find(m_options.filter) == std::string::npos)
+            return;
+
+        using clock = std::chrono::steady_clock;
+
+        //Grows the call count until one run takes a measurable time, then sizes runs to share min_time.
+        size_t calls = 1;
+        for (;;) {
+            const clock::time_point start = clock::now();
+            for (size_t i = 0; i < calls; ++i)
+                body();
+            const double elapsed = std::chrono::duration<double>(clock::now() - start).count();
+            if (elapsed >= 0.002) {
+                const double target = m_options.min_time / m_options.repetitions;
+                calls = std::max<size_t>(1, static_cast<size_t>(calls * target / elapsed));
+                break;
+            }
+            calls *= 2;
+        }
+
+        double best_ns = 1e300, best_cycles = 1e300;
+        for (int r = 0; r < m_options.repetitions; ++r) {
+            const clock::time_point start = clock::now();
+            const uint64_t tsc = ticks();
+            for (size_t i = 0; i < calls; ++i)
+                body();
+            const uint64_t cycles = ticks() - tsc;
+            const double ns = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+            best_ns = std::min(best_ns, ns / (double(calls) * outputs));
+            best_cycles = std::min(best_cycles, double(cycles) / (double(calls) * outputs));
+        }
+
+        m_results.push_back(result { engine, width, benchmark, output_bytes, best_ns, best_cycles });
+    }
+
+    void print() const
+    {
+        if (m_options.json) {
+            std::printf("{\n  \"isa\": \"%s\",\n  \"compiler\": \"%s\",\n  \"results\": [\n", compiled_isa(), __VERSION__);
+            for (size_t i = 0; i < m_results.size(); ++i) {
+                const result& r = m_results[i];
+                std::printf("    {\"engine\": \"%s\", \"width\": \"%s\", \"benchmark\": \"%s\", \"output_bytes\": %zu, "
+                            "\"bytes_per_second\": %.6g, \"ns_per_output\": %.6g, \"cycles_per_output\": %.6g}%s\n",
+                    r.engine.c_str(), r.width.c_str(), r.benchmark.c_str(), r.output_bytes, r.output_bytes / r.ns_per_output * 1e9,
+                    r.ns_per_output, r.cycles_per_output, i + 1 == m_results.size() ? "" : ",");
+            }
+            std::printf("  ]\n}\n");
+        } else {
+            std::printf("isa,engine,width,benchmark,output_bytes,bytes_per_second,ns_per_output,cycles_per_output\n");
+            for (const result& r : m_results)
+                std::printf("%s,%s,%s,%s,%zu,%.6g,%.6g,%.6g\n", compiled_isa(), r.engine.c_str(), r.width.c_str(), r.benchmark.c_str(),
+                    r.output_bytes, r.output_bytes / r.ns_per_output * 1e9, r.ns_per_output, r.cycles_per_output);
+        }
+    }
+
+private:
+    options m_options;
+    std::vector<result> m_results;
+};
+
+//Outputs per bulk call: 64 KiB of uint64_t, which stays in L2 so the memory bandwidth does not cap the results.
+constexpr size_t bulk = 8192;
+
+//Calls of next() per measured body, so the loop overhead of the runner does not show.
+constexpr size_t calls_per_body = 1024;
+
+constexpr uint64_t seed = 0x5eed5eed5eed5eed;
+
+template <typename Engine>
+void run_common(runner& r, const char* engine_name, const char* width)
+{
+    using output_type = decltype(std::declval<Engine&>().next());
+    constexpr size_t words = sizeof(output_type) / sizeof(uint64_t);
+
+    Engine engine { splitmix::splitmix64(seed) };
+    std::vector<uint64_t> words_buffer(bulk);
+    std::vector<double> doubles(bulk);
+    std::vector<uint32_t> halves(bulk);
+    std::vector<float> floats(bulk);
+
+    r.run(engine_name, width, "next", calls_per_body * words, sizeof(uint64_t), [&engine]() {
+        for (size_t i = 0; i < calls_per_body; ++i) {
+            output_type v = engine.next();
+            keep(v);
+        }
+    });
+
+    r.run(engine_name, width, "fill", bulk, sizeof(uint64_t), [&engine, &words_buffer]() {
+        engine.fill(words_buffer.data(), bulk);
+        escape(words_buffer.data());
+    });
+
+    r.run(engine_name, width, "uniform_double", bulk, sizeof(double), [&engine, &doubles]() {
+        simdrand::fill_uniform(engine, doubles.data(), bulk);
+        escape(doubles.data());
+    });
+
+    r.run(engine_name, width, "fill_u32", bulk, sizeof(uint32_t), [&engine, &halves]() {
+        simdrand::fill_u32(engine, halves.data(), bulk);
+        escape(halves.data());
+    });
+
+    r.run(engine_name, width, "uniform_float", bulk, sizeof(float), [&engine, &floats]() {
+        simdrand::fill_uniform(engine, floats.data(), bulk);
+        escape(floats.data());
+    });
+}
+
+#ifdef __AVX2__
+
+//Bounded integers are only implemented for the 4 and 8 lane engines.
+template <typename Engine>
+void run_bounded(runner& r, const char* engine_name, const char* width)
+{
+    Engine engine { splitmix::splitmix64(seed) };
+    std::vector<uint32_t> bounded(bulk);
+
+    //A range just above 2^31 rejects almost half of the candidates, a small one almost none.
+    r.run(engine_name, width, "bounded_1000", bulk, sizeof(uint32_t), [&engine, &bounded]() {
+        simdrand::fill_bounded(engine, bounded.data(), bulk, 1000U);
+        escape(bounded.data());
+    });
+
+    r.run(engine_name, width, "bounded_2^31+1", bulk, sizeof(uint32_t), [&engine, &bounded]() {
+        simdrand::fill_bounded(engine, bounded.data(), bulk, 0x80000001U);
+        escape(bounded.data());
+    });
+}
+
+//Normal doubles are only implemented for the 4 and 8 lane engines.
+template <typename Engine>
+void run_normal(runner& r, const char* engine_name, const char* width)
+{
+    Engine engine { splitmix::splitmix64(seed) };
+    std::vector<double> normals(bulk);
+
+    r.run(engine_name, width, "fill_normal", bulk, sizeof(double), [&engine, &normals]() {
+        simdrand::fill_normal(engine, normals.data(), bulk);
+        escape(normals.data());
+    });
+
+    r.run(engine_name, width, "fill_normal_box_muller", bulk, sizeof(double), [&engine, &normals]() {
+        simdrand::fill_normal_box_muller(engine, normals.data(), bulk);
+        escape(normals.data());
+    });
+}
+
+#endif // __AVX2__
+
+//std::normal_distribution<double> on std::mt19937_64, the baseline of the fill_normal rows.
+void run_std_normal(runner& r)
+{
+    std::mt19937_64 engine(seed);
+    std::normal_distribution<double> normal;
+    std::vector<double> normals(bulk);
+
+    r.run("std::mt19937_64", "1", "std::normal_distribution", bulk, sizeof(double), [&engine, &normal, &normals]() {
+        for (double& x : normals)
+            x = normal(engine);
+        escape(normals.data());
+    });
+}
+
+template <typename Engine>
+void run_dispatch(runner& r, const char* engine_name)
+{
+    Engine engine { splitmix::splitmix64(seed) };
+    std::vector<uint64_t> words_buffer(bulk);
+    std::vector<uint32_t> halves(bulk);
+
+    r.run(engine_name, "dispatch", "fill", bulk, sizeof(uint64_t), [&engine, &words_buffer]() {
+        engine.fill(words_buffer.data(), bulk);
+        escape(words_buffer.data());
+    });
+
+    r.run(engine_name, "dispatch", "fill_u32", bulk, sizeof(uint32_t), [&engine, &halves]() {
+        engine.fill_u32(halves.data(), bulk);
+        escape(halves.data());
+    });
+}
+
+//Small draws from a bit_pool over Engine, compared with spending a whole next() of the scalar engine on each.
+template <typename Engine>
+void run_bits(runner& r, const char* engine_name, const char* width)
+{
+    simdrand::bit_pool<Engine> pool { splitmix::splitmix64(seed) };
+
+    r.run(engine_name, width, "pool_bool", calls_per_body, sizeof(bool), [&pool]() {
+        for (size_t i = 0; i < calls_per_body; ++i) {
+            uint64_t v = pool.next_bool();
+            keep(v);
+        }
+    });
+
+    r.run(engine_name, width, "pool_bits_4", calls_per_body, sizeof(uint8_t), [&pool]() {
+        for (size_t i = 0; i < calls_per_body; ++i) {
+            uint64_t v = pool.next_bits(4);
+            keep(v);
+        }
+    });
+
+    r.run(engine_name, width, "pool_byte", calls_per_body, sizeof(uint8_t), [&pool]() {
+        for (size_t i = 0; i < calls_per_body; ++i) {
+            uint64_t v = pool.next_byte();
+            keep(v);
+        }
+    });
+
+    r.run(engine_name, width, "pool_bernoulli", calls_per_body, sizeof(bool), [&pool]() {
+        for (size_t i = 0; i < calls_per_body; ++i) {
+            uint64_t v = pool.next_bernoulli(0.3);
+            keep(v);
+        }
+    });
+}
+
+//Comparisons and hashes of engine states, as in duplicate and cycle detection over many saved states. The states
+//compared are equal, the worst case in which every word has to be looked at.
+template <typename Engine>
+void run_state(runner& r, const char* engine_name, const char* width)
+{
+    const std::vector<Engine> states(calls_per_body + 1, Engine { splitmix::splitmix64(seed) });
+
+    r.run(engine_name, width, "equal", calls_per_body, sizeof(Engine), [&states]() {
+        uint64_t equal = 0;
+        for (size_t i = 0; i < calls_per_body; ++i)
+            equal += states[i] == states[i + 1];
+        keep(equal);
+    });
+
+    r.run(engine_name, width, "state_hash", calls_per_body, sizeof(Engine), [&states]() {
+        uint64_t hash = 0;
+        for (size_t i = 0; i < calls_per_body; ++i)
+            hash ^= states[i].state_hash();
+        keep(hash);
+    });
+}
+
+template <typename Scalar, typename Dispatch>
+void run_scalar(runner& r, const char* engine_name)
+{
+    run_common<Scalar>(r, engine_name, "1");
+    run_dispatch<Dispatch>(r, engine_name);
+}
+
+void run_all(runner& r)
+{
+    run_common<mt19937_64>(r, "std::mt19937_64", "1");
+    run_std_normal(r);
+
+    run_common<splitmix::splitmix64>(r, "splitmix64", "1");
+    run_common<philox::philox4x32_10>(r, "philox4x32_10", "1");
+    run_scalar<xorshift64::xorshift64, xorshift64::dispatch>(r, "xorshift64");
+    run_scalar<xorshift128plus::xorshift128plus, xorshift128plus::dispatch>(r, "xorshift128plus");
+    run_scalar<xoroshiro128plus::xoroshiro128plus, xoroshiro128plus::dispatch>(r, "xoroshiro128plus");
+    run_scalar<xoroshiro128plusplus::xoroshiro128plusplus, xoroshiro128plusplus::dispatch>(r, "xoroshiro128plusplus");
+    run_scalar<xoshiro256plusplus::xoshiro256plusplus, xoshiro256plusplus::dispatch>(r, "xoshiro256plusplus");
+    run_scalar<xoshiro256ss::xoshiro256ss, xoshiro256ss::dispatch>(r, "xoshiro256ss");
+
+    run_bits<xoshiro256plusplus::xoshiro256plusplus>(r, "xoshiro256plusplus", "1");
+    run_bits<xoshiro256plusplus::dispatch>(r, "xoshiro256plusplus", "dispatch");
+
+    run_state<splitmix::splitmix64>(r, "splitmix64", "1");
+    run_state<xoroshiro128plus::xoroshiro128plus>(r, "xoroshiro128plus", "1");
+    run_state<xoshiro256plusplus::xoshiro256plusplus>(r, "xoshiro256plusplus", "1");
+
+#if defined __SSE4_1__ || defined SIMDRAND_NEON
+    run_common<splitmix::splitmix64_2>(r, "splitmix64", "2");
+    run_state<splitmix::splitmix64_2>(r, "splitmix64", "2");
+#endif
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+    run_common<xorshift64::xorshift64_2>(r, "xorshift64", "2");
+    run_common<xorshift128plus::xorshift128plus_2>(r, "xorshift128plus", "2");
+    run_common<xoroshiro128plus::xoroshiro128plus_2>(r, "xoroshiro128plus", "2");
+    run_common<xoroshiro128plusplus::xoroshiro128plusplus_2>(r, "xoroshiro128plusplus", "2");
+    run_common<xoshiro256plusplus::xoshiro256plusplus_2>(r, "xoshiro256plusplus", "2");
+    run_common<xoshiro256ss::xoshiro256ss_2>(r, "xoshiro256ss", "2");
+    run_state<xoroshiro128plus::xoroshiro128plus_2>(r, "xoroshiro128plus", "2");
+    run_state<xoshiro256plusplus::xoshiro256plusplus_2>(r, "xoshiro256plusplus", "2");
+    run_common<philox::philox4x32_10_2>(r, "philox4x32_10", "2");
+
+    run_common<simdrand::interleaved<xoroshiro128plus::xoroshiro128plus_2, 2>>(r, "xoroshiro128plus", "2x2");
+    run_common<simdrand::interleaved<xoshiro256plusplus::xoshiro256plusplus_2, 2>>(r, "xoshiro256plusplus", "2x2");
+#endif
+
+#ifdef __AVX2__
+    run_common<splitmix::splitmix64_4>(r, "splitmix64", "4");
+    run_common<xorshift64::xorshift64_4>(r, "xorshift64", "4");
+    run_common<xorshift128plus::xorshift128plus_4>(r, "xorshift128plus", "4");
+    run_common<xoroshiro128plus::xoroshiro128plus_4>(r, "xoroshiro128plus", "4");
+    run_common<xoroshiro128plusplus::xoroshiro128plusplus_4>(r, "xoroshiro128plusplus", "4");
+    run_common<xoshiro256plusplus::xoshiro256plusplus_4>(r, "xoshiro256plusplus", "4");
+    run_common<xoshiro256ss::xoshiro256ss_4>(r, "xoshiro256ss", "4");
+    run_common<philox::philox4x32_10_4>(r, "philox4x32_10", "4");
+
+    run_state<splitmix::splitmix64_4>(r, "splitmix64", "4");
+    run_state<xoroshiro128plus::xoroshiro128plus_4>(r, "xoroshiro128plus", "4");
+    run_state<xoshiro256plusplus::xoshiro256plusplus_4>(r, "xoshiro256plusplus", "4");
+
+    run_common<simdrand::interleaved<xoroshiro128plus::xoroshiro128plus_4, 2>>(r, "xoroshiro128plus", "4x2");
+    run_common<simdrand::interleaved<xoshiro256plusplus::xoshiro256plusplus_4, 2>>(r, "xoshiro256plusplus", "4x2");
+    run_common<simdrand::interleaved<philox::philox4x32_10_4, 4>>(r, "philox4x32_10", "4x4");
+
+    run_bounded<splitmix::splitmix64_4>(r, "splitmix64", "4");
+    run_bounded<xorshift64::xorshift64_4>(r, "xorshift64", "4");
+    run_bounded<xorshift128plus::xorshift128plus_4>(r, "xorshift128plus", "4");
+    run_bounded<xoroshiro128plus::xoroshiro128plus_4>(r, "xoroshiro128plus", "4");
+    run_bounded<xoroshiro128plusplus::xoroshiro128plusplus_4>(r, "xoroshiro128plusplus", "4");
+    run_bounded<xoshiro256plusplus::xoshiro256plusplus_4>(r, "xoshiro256plusplus", "4");
+    run_bounded<xoshiro256ss::xoshiro256ss_4>(r, "xoshiro256ss", "4");
+    run_bounded<philox::philox4x32_10_4>(r, "philox4x32_10", "4");
+
+    run_normal<xoshiro256plusplus::xoshiro256plusplus_4>(r, "xoshiro256plusplus", "4");
+    run_normal<xoroshiro128plus::xoroshiro128plus_4>(r, "xoroshiro128plus", "4");
+#endif
+
+#ifdef __AVX512F__
+    run_common<splitmix::splitmix64_8>(r, "splitmix64", "8");
+    run_common<xorshift64::xorshift64_8>(r, "xorshift64", "8");
+    run_common<xorshift128plus::xorshift128plus_8>(r, "xorshift128plus", "8");
+    run_common<xoroshiro128plus::xoroshiro128plus_8>(r, "xoroshiro128plus", "8");
+    run_common<xoroshiro128plusplus::xoroshiro128plusplus_8>(r, "xoroshiro128plusplus", "8");
+    run_common<xoshiro256plusplus::xoshiro256plusplus_8>(r, "xoshiro256plusplus", "8");
+    run_common<xoshiro256ss::xoshiro256ss_8>(r, "xoshiro256ss", "8");
+    run_common<philox::philox4x32_10_8>(r, "philox4x32_10", "8");
+
+    run_state<splitmix::splitmix64_8>(r, "splitmix64", "8");
+    run_state<xoroshiro128plus::xoroshiro128plus_8>(r, "xoroshiro128plus", "8");
+    run_state<xoshiro256plusplus::xoshiro256plusplus_8>(r, "xoshiro256plusplus", "8");
+
+    run_bounded<splitmix::splitmix64_8>(r, "splitmix64", "8");
+    run_bounded<xorshift64::xorshift64_8>(r, "xorshift64", "8");
+    run_bounded<xorshift128plus::xorshift128plus_8>(r, "xorshift128plus", "8");
+    run_bounded<xoroshiro128plus::xoroshiro128plus_8>(r, "xoroshiro128plus", "8");
+    run_bounded<xoroshiro128plusplus::xoroshiro128plusplus_8>(r, "xoroshiro128plusplus", "8");
+    run_bounded<xoshiro256plusplus::xoshiro256plusplus_8>(r, "xoshiro256plusplus", "8");
+    run_bounded<xoshiro256ss::xoshiro256ss_8>(r, "xoshiro256ss", "8");
+    run_bounded<philox::philox4x32_10_8>(r, "philox4x32_10", "8");
+
+    run_normal<xoshiro256plusplus::xoshiro256plusplus_8>(r, "xoshiro256plusplus", "8");
+    run_normal<xoroshiro128plus::xoroshiro128plus_8>(r, "xoroshiro128plus", "8");
+#endif
+}
+
+//Outputs filled by parallel_fill() per call: 256 MiB, so the result is bound by memory bandwidth rather than the caches.
+constexpr size_t parallel_bulk = size_t(1) << 25;
+
+//Runs before pin(), as the worker threads inherit the affinity of the calling thread.
+void run_parallel(runner& r, unsigned max_threads)
+{
+    //Aligned to a cache line, as large buffers usually are, so fill() can use non-temporal stores.
+    std::vector<uint64_t> storage(parallel_bulk + 8);
+    uint64_t* const words = storage.data() + (8 - reinterpret_cast<uintptr_t>(storage.data()) / sizeof(uint64_t) % 8) % 8;
+
+    r.run("std::memset", "1", "fill", parallel_bulk, sizeof(uint64_t), [words]() {
+        std::memset(words, 0x5e, parallel_bulk * sizeof(uint64_t));
+        escape(words);
+    });
+
+    for (unsigned threads = 1;; threads = std::min(2 * threads, max_threads)) {
+        const std::string benchmark = "parallel_fill_x" + std::to_string(threads);
+        r.run("xorshift128plus", "dispatch", benchmark.c_str(), parallel_bulk, sizeof(uint64_t), [words, threads]() {
+            simdrand::parallel_fill(words, parallel_bulk, seed, threads);
+            escape(words);
+        });
+        if (threads == max_threads)
+            break;
+    }
+}
+
+//Pins the calling thread to cpu, or to the CPU it is running on if cpu is negative, so it neither migrates
+//between cores mid-measurement nor lands on a core with a different clock.
+void pin(int cpu)
+{
+#ifdef __linux__
+    if (cpu < 0)
+        cpu = sched_getcpu();
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        std::fprintf(stderr, "warning: could not pin to CPU %d\n", cpu);
+#else
+    (void)cpu;
+#endif
+}
+
+bool parse(int argc, char** argv, options& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--json") == 0)
+            opt.json = true;
+        else if (std::strcmp(argv[i], "--cpu") == 0 && has_value)
+            opt.cpu = std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--threads") == 0 && has_value)
+            opt.threads = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--filter") == 0 && has_value)
+            opt.filter = argv[++i];
+        else if (std::strcmp(argv[i], "--min-time") == 0 && has_value)
+            opt.min_time = std::atof(argv[++i]);
+        else if (std::strcmp(argv[i], "--repetitions") == 0 && has_value)
+            opt.repetitions = std::max(1, std::atoi(argv[++i]));
+        else
+            return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    options opt;
+    if (!parse(argc, argv, opt)) {
+        std::fprintf(stderr, "usage: %s [--json] [--cpu N] [--threads N] [--filter TEXT] [--min-time SECONDS] [--repetitions N]\n", argv[0]);
+        return 2;
+    }
+
+    runner r(opt);
+    run_parallel(r, opt.threads);
+
+    pin(opt.cpu);
+    run_all(r);
+    r.print();
+    return 0;
+}
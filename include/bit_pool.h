@@ -0,0 +1,121 @@
+#ifndef BIT_POOL_H_INCLUDED
+#define BIT_POOL_H_INCLUDED
+
+//Adapter serving random values a few bits at a time, for hot loops that need booleans, small indices or bytes and
+//would otherwise spend a whole next() on each. The bits come from a cache-line aligned block the engine refills with
+//its bulk fill(); a draw only shifts bits out of the current word, and a new word is loaded out of line.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "bulk.h"
+#include "splitmix.h"
+
+namespace simdrand {
+
+//Pool of random bits taken from the outputs of Engine in the order fill() stores them: bit i of the pool is bit i % 64
+//of output i / 64, and next_bits(k) returns the next k of them with the first one in the least significant bit.
+//Engine is any engine with a bulk fill(), scalar, SIMD or dispatch; Size is the number of buffered outputs.
+template <typename Engine, size_t Size = 512>
+struct bit_pool {
+    static_assert(Size != 0 && Size % 8 == 0, "Size must be a whole number of next() results for every width");
+
+    explicit bit_pool(const Engine& engine) noexcept
+        : m_engine(engine)
+        , m_word(1)
+        , m_index(Size)
+    {
+    }
+
+    explicit bit_pool(splitmix::splitmix64 gen) noexcept
+        : m_engine(gen)
+        , m_word(1)
+        , m_index(Size)
+    {
+    }
+
+    //Returns k random bits in the low bits of the result, 1 <= k <= 64.
+    uint64_t next_bits(unsigned k) noexcept
+    {
+        //Fewer than k bits are left when the sentinel is below bit k; with a constant k this is a single compare.
+        if (__builtin_expect(m_word >> (k - 1) <= 1, 0))
+            return next_bits_next_word(k);
+
+        //k < 64 here, as a word never holds more than 63 unused bits.
+        const uint64_t bits = m_word & (UINT64_MAX >> (64 - k));
+        m_word >>= k;
+        return bits;
+    }
+
+    //Returns a random bool, consuming a single bit.
+    bool next_bool() noexcept
+    {
+        return next_bits(1) != 0;
+    }
+
+    //Returns a random byte, consuming 8 bits.
+    uint8_t next_byte() noexcept
+    {
+        return static_cast<uint8_t>(next_bits(8));
+    }
+
+    //Returns true with probability p, rounded down to a multiple of 2^-32, consuming 32 bits.
+    //p <= 0 and NaN never return true and p >= 1 always does.
+    bool next_bernoulli(double p) noexcept
+    {
+        const uint64_t threshold = !(p > 0.0) ? 0 : p >= 1.0 ? UINT64_C(1) << 32 : static_cast<uint64_t>(p * 4294967296.0);
+        return next_bits(32) < threshold;
+    }
+
+    //Number of bits left before the engine is called again.
+    constexpr size_t available() const noexcept { return left() + (Size - m_index) * 64; }
+
+    //Wrapped engine, already advanced past the buffered outputs.
+    const Engine& engine() const noexcept { return m_engine; }
+
+    //Compares the bits that remain to be consumed and the states of the wrapped engines for equality.
+    bool operator==(const bit_pool& other) const noexcept
+    {
+        return m_word == other.m_word && m_index == other.m_index && m_engine == other.m_engine
+            && std::memcmp(m_buffer + m_index, other.m_buffer + m_index, (Size - m_index) * sizeof(uint64_t)) == 0;
+    }
+
+    //Compares the bits that remain to be consumed and the states of the wrapped engines for inequality.
+    bool operator!=(const bit_pool& other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+    //Completes a draw the current word cannot serve with the low bits of the next one, refilling the block when it
+    //is used up. Kept out of line so the draws stay small enough to inline at every call site.
+    __attribute__((noinline)) uint64_t next_bits_next_word(unsigned k) noexcept
+    {
+        if (m_index == Size) {
+            m_engine.fill(m_buffer, Size);
+            m_index = 0;
+        }
+
+        const unsigned left = this->left();
+        const uint64_t word = m_buffer[m_index++];
+        const unsigned taken = k - left;
+        const uint64_t bits = ((m_word ^ UINT64_C(1) << left) | word << left) & (UINT64_MAX >> (64 - k));
+        m_word = (word >> 1 >> (taken - 1)) | UINT64_C(1) << (64 - taken);
+        return bits;
+    }
+
+    //Number of unused bits in m_word.
+    constexpr unsigned left() const noexcept { return 63 - __builtin_clzll(m_word); }
+
+    alignas(64) uint64_t m_buffer[Size];
+    Engine m_engine;
+    //Unused bits of the last word taken from m_buffer, shifted down so the next one is bit 0, followed by a set
+    //sentinel bit that marks how many there are; 1 when none are left.
+    uint64_t m_word;
+    size_t m_index;
+};
+
+}
+
+#endif // BIT_POOL_H_INCLUDED
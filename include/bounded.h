@@ -0,0 +1,301 @@
+#ifndef BOUNDED_H_INCLUDED
+#define BOUNDED_H_INCLUDED
+
+//Unbiased random integers in [0, range) with Lemire's nearly divisionless method (https://arxiv.org/abs/1805.10941):
+//a random word x is multiplied by range, the high half of the product is the result and the low half decides rejection.
+//Candidates are only rejected when the low half is below 2^32 % range (2^64 % range), so the division is rare or hoisted.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "simd.h"
+
+namespace simdrand {
+
+namespace detail {
+
+#ifdef __AVX2__
+
+    //Permutations packing the 32-bit elements selected by an 8-bit mask to the front of a __m256i, one index per byte.
+    struct compress_table {
+        uint64_t entries[256];
+
+        constexpr compress_table() noexcept
+            : entries()
+        {
+            for (unsigned mask = 0; mask < 256; ++mask) {
+                unsigned k = 0;
+                for (unsigned i = 0; i < 8; ++i)
+                    if (mask & (1U << i))
+                        entries[mask] |= uint64_t(i) << (8 * k++);
+            }
+        }
+    };
+
+    inline void broadcast32(__m256i& v, uint32_t x) noexcept { v = _mm256_set1_epi32(static_cast<int>(x)); }
+    inline void broadcast64(__m256i& v, uint64_t x) noexcept { v = _mm256_set1_epi64x(static_cast<long long>(x)); }
+
+    //Multiplies every 32-bit element of x by range; returns the high halves of the products and stores the low halves in fraction.
+    inline __m256i multiply32(__m256i x, __m256i range, __m256i& fraction) noexcept
+    {
+        const __m256i even = _mm256_mul_epu32(x, range);
+        const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), range);
+        fraction = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+        return _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+    }
+
+    //Multiplies every 64-bit lane of x by range, built from 32-bit partial products; returns the high halves of the
+    //128-bit products and stores the low halves in fraction.
+    inline __m256i multiply64(__m256i x, __m256i range, __m256i& fraction) noexcept
+    {
+        const __m256i low = _mm256_set1_epi64x(0xffffffff);
+        const __m256i x_hi = _mm256_srli_epi64(x, 32);
+        const __m256i range_hi = _mm256_srli_epi64(range, 32);
+
+        const __m256i ll = _mm256_mul_epu32(x, range);
+        const __m256i lh = _mm256_mul_epu32(x, range_hi);
+        const __m256i hl = _mm256_mul_epu32(x_hi, range);
+        const __m256i hh = _mm256_mul_epu32(x_hi, range_hi);
+
+        const __m256i mid = _mm256_add_epi64(_mm256_add_epi64(_mm256_srli_epi64(ll, 32), _mm256_and_si256(lh, low)), _mm256_and_si256(hl, low));
+        fraction = _mm256_blend_epi32(ll, _mm256_slli_epi64(mid, 32), 0xaa);
+        return _mm256_add_epi64(_mm256_add_epi64(hh, _mm256_srli_epi64(mid, 32)), _mm256_add_epi64(_mm256_srli_epi64(lh, 32), _mm256_srli_epi64(hl, 32)));
+    }
+
+    //Bit i is set if 32-bit element i of x is below bound (unsigned).
+    inline unsigned below32(__m256i x, __m256i bound) noexcept
+    {
+        const __m256i not_below = _mm256_cmpeq_epi32(_mm256_max_epu32(x, bound), x);
+        return ~static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(not_below))) & 0xffU;
+    }
+
+    //Bit i is set if 64-bit lane i of x is below bound (unsigned).
+    inline unsigned below64(__m256i x, __m256i bound) noexcept
+    {
+        const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+        const __m256i below = _mm256_cmpgt_epi64(_mm256_xor_si256(bound, sign), _mm256_xor_si256(x, sign));
+        return static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(below)));
+    }
+
+    //Takes the 32-bit elements of b selected by mask and the rest from a.
+    inline __m256i select32(__m256i a, __m256i b, unsigned mask) noexcept
+    {
+        const __m256i bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256i take = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(mask)), bits), bits);
+        return _mm256_blendv_epi8(a, b, take);
+    }
+
+    //Takes the 64-bit lanes of b selected by mask and the rest from a.
+    inline __m256i select64(__m256i a, __m256i b, unsigned mask) noexcept
+    {
+        const __m256i bits = _mm256_setr_epi64x(1, 2, 4, 8);
+        const __m256i take = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(mask), bits), bits);
+        return _mm256_blendv_epi8(a, b, take);
+    }
+
+    //Moves the 32-bit elements selected by mask to the front, keeping their order.
+    inline __m256i compress32(__m256i x, unsigned mask) noexcept
+    {
+        static constexpr compress_table table {};
+        const __m256i permutation = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(&table.entries[mask])));
+        return _mm256_permutevar8x32_epi32(x, permutation);
+    }
+
+    //Moves the 64-bit lanes selected by mask to the front, keeping their order.
+    inline __m256i compress64(__m256i x, unsigned mask) noexcept
+    {
+        //Every lane bit is doubled to select both 32-bit halves of the lane.
+        return compress32(x, (mask & 1U) * 3U | (mask & 2U) * 6U | (mask & 4U) * 12U | (mask & 8U) * 24U);
+    }
+
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+
+    inline void broadcast32(__m512i& v, uint32_t x) noexcept { v = _mm512_set1_epi32(static_cast<int>(x)); }
+    inline void broadcast64(__m512i& v, uint64_t x) noexcept { v = _mm512_set1_epi64(static_cast<long long>(x)); }
+
+    //Multiplies every 32-bit element of x by range; returns the high halves of the products and stores the low halves in fraction.
+    inline __m512i multiply32(__m512i x, __m512i range, __m512i& fraction) noexcept
+    {
+        const __m512i even = _mm512_mul_epu32(x, range);
+        const __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(x, 32), range);
+        fraction = _mm512_mask_blend_epi32(0xaaaa, even, _mm512_slli_epi64(odd, 32));
+        return _mm512_mask_blend_epi32(0xaaaa, _mm512_srli_epi64(even, 32), odd);
+    }
+
+    //Multiplies every 64-bit lane of x by range, built from 32-bit partial products; returns the high halves of the
+    //128-bit products and stores the low halves in fraction.
+    inline __m512i multiply64(__m512i x, __m512i range, __m512i& fraction) noexcept
+    {
+        const __m512i low = _mm512_set1_epi64(0xffffffff);
+        const __m512i x_hi = _mm512_srli_epi64(x, 32);
+        const __m512i range_hi = _mm512_srli_epi64(range, 32);
+
+        const __m512i ll = _mm512_mul_epu32(x, range);
+        const __m512i lh = _mm512_mul_epu32(x, range_hi);
+        const __m512i hl = _mm512_mul_epu32(x_hi, range);
+        const __m512i hh = _mm512_mul_epu32(x_hi, range_hi);
+
+        const __m512i mid = _mm512_add_epi64(_mm512_add_epi64(_mm512_srli_epi64(ll, 32), _mm512_and_si512(lh, low)), _mm512_and_si512(hl, low));
+        fraction = _mm512_mask_blend_epi32(0xaaaa, ll, _mm512_slli_epi64(mid, 32));
+        return _mm512_add_epi64(_mm512_add_epi64(hh, _mm512_srli_epi64(mid, 32)), _mm512_add_epi64(_mm512_srli_epi64(lh, 32), _mm512_srli_epi64(hl, 32)));
+    }
+
+    //Bit i is set if 32-bit element i of x is below bound (unsigned).
+    inline unsigned below32(__m512i x, __m512i bound) noexcept
+    {
+        return _mm512_cmplt_epu32_mask(x, bound);
+    }
+
+    //Bit i is set if 64-bit lane i of x is below bound (unsigned).
+    inline unsigned below64(__m512i x, __m512i bound) noexcept
+    {
+        return _mm512_cmplt_epu64_mask(x, bound);
+    }
+
+    //Takes the 32-bit elements of b selected by mask and the rest from a.
+    inline __m512i select32(__m512i a, __m512i b, unsigned mask) noexcept
+    {
+        return _mm512_mask_blend_epi32(static_cast<__mmask16>(mask), a, b);
+    }
+
+    //Takes the 64-bit lanes of b selected by mask and the rest from a.
+    inline __m512i select64(__m512i a, __m512i b, unsigned mask) noexcept
+    {
+        return _mm512_mask_blend_epi64(static_cast<__mmask8>(mask), a, b);
+    }
+
+    //Moves the 32-bit elements selected by mask to the front, keeping their order.
+    inline __m512i compress32(__m512i x, unsigned mask) noexcept
+    {
+        return _mm512_maskz_compress_epi32(static_cast<__mmask16>(mask), x);
+    }
+
+    //Moves the 64-bit lanes selected by mask to the front, keeping their order.
+    inline __m512i compress64(__m512i x, unsigned mask) noexcept
+    {
+        return _mm512_maskz_compress_epi64(static_cast<__mmask8>(mask), x);
+    }
+
+#endif // __AVX512F__
+
+#ifdef __AVX2__
+
+    //Writes the values accepted from consecutive outputs of engine to dst until n values are written.
+    template <typename Element, typename Engine, typename Vector>
+    inline void fill_bounded(Engine& engine, Element* dst, size_t n, Vector range, Vector threshold) noexcept
+    {
+        constexpr bool wide = sizeof(Element) == sizeof(uint64_t);
+        constexpr size_t count = sizeof(Vector) / sizeof(Element);
+        constexpr unsigned all = (1U << count) - 1;
+
+        while (n != 0) {
+            Vector fraction;
+            Vector x = wide ? multiply64(engine.next(), range, fraction) : multiply32(engine.next(), range, fraction);
+
+            const unsigned accepted = all & ~(wide ? below64(fraction, threshold) : below32(fraction, threshold));
+            if (accepted != all)
+                x = wide ? compress64(x, accepted) : compress32(x, accepted);
+
+            size_t k = static_cast<size_t>(__builtin_popcount(accepted));
+            if (n >= count) {
+                std::memcpy(dst, &x, sizeof(Vector));
+            } else {
+                k = k < n ? k : n;
+                std::memcpy(dst, &x, k * sizeof(Element));
+            }
+            dst += k;
+            n -= k;
+        }
+    }
+
+#endif // __AVX2__
+
+} // namespace detail
+
+#ifdef __AVX2__
+
+//Generates a vector of independent 32-bit integers uniformly distributed in [0, range), range must not be 0.
+//Every 32-bit half of next() is a candidate; rejected elements are replaced by candidates from further next() calls.
+template <typename Engine>
+inline auto next_bounded(Engine& engine, uint32_t range) noexcept -> decltype(engine.next())
+{
+    using vector_type = decltype(engine.next());
+    vector_type r, fraction;
+    detail::broadcast32(r, range);
+    vector_type result = detail::multiply32(engine.next(), r, fraction);
+
+    //2^32 % range is only needed if some fraction is below range, which is rare for small ranges.
+    if (detail::below32(fraction, r) != 0) {
+        vector_type threshold;
+        detail::broadcast32(threshold, (0U - range) % range);
+        unsigned rejected = detail::below32(fraction, threshold);
+        while (rejected != 0) {
+            const vector_type candidate = detail::multiply32(engine.next(), r, fraction);
+            const unsigned accepted = rejected & ~detail::below32(fraction, threshold);
+            result = detail::select32(result, candidate, accepted);
+            rejected &= ~accepted;
+        }
+    }
+
+    return result;
+}
+
+//Generates a vector of independent 64-bit integers uniformly distributed in [0, range), range must not be 0.
+//Every lane of next() is a candidate; rejected lanes are replaced by candidates from further next() calls.
+template <typename Engine>
+inline auto next_bounded64(Engine& engine, uint64_t range) noexcept -> decltype(engine.next())
+{
+    using vector_type = decltype(engine.next());
+    vector_type r, fraction;
+    detail::broadcast64(r, range);
+    vector_type result = detail::multiply64(engine.next(), r, fraction);
+
+    //2^64 % range is only needed if some fraction is below range, which is rare for small ranges.
+    if (detail::below64(fraction, r) != 0) {
+        vector_type threshold;
+        detail::broadcast64(threshold, (0U - range) % range);
+        unsigned rejected = detail::below64(fraction, threshold);
+        while (rejected != 0) {
+            const vector_type candidate = detail::multiply64(engine.next(), r, fraction);
+            const unsigned accepted = rejected & ~detail::below64(fraction, threshold);
+            result = detail::select64(result, candidate, accepted);
+            rejected &= ~accepted;
+        }
+    }
+
+    return result;
+}
+
+//Fills dst with n integers uniformly distributed in [0, range), range must not be 0.
+//The output equals scalar Lemire sampling applied to the consecutive 32-bit halves of next(), low half first:
+//rejected candidates are skipped and the accepted ones are packed together without leaving the vector units.
+template <typename Engine>
+inline void fill_bounded(Engine& engine, uint32_t* dst, size_t n, uint32_t range) noexcept
+{
+    using vector_type = decltype(engine.next());
+    vector_type r, threshold;
+    detail::broadcast32(r, range);
+    detail::broadcast32(threshold, (0U - range) % range);
+    detail::fill_bounded(engine, dst, n, r, threshold);
+}
+
+//Fills dst with n integers uniformly distributed in [0, range), range must not be 0.
+//The output equals scalar Lemire sampling applied to the consecutive lanes of next().
+template <typename Engine>
+inline void fill_bounded(Engine& engine, uint64_t* dst, size_t n, uint64_t range) noexcept
+{
+    using vector_type = decltype(engine.next());
+    vector_type r, threshold;
+    detail::broadcast64(r, range);
+    detail::broadcast64(threshold, (0U - range) % range);
+    detail::fill_bounded(engine, dst, n, r, threshold);
+}
+
+#endif // __AVX2__
+
+}
+
+#endif // BOUNDED_H_INCLUDED
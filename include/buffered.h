@@ -0,0 +1,87 @@
+#ifndef BUFFERED_H_INCLUDED
+#define BUFFERED_H_INCLUDED
+
+//Adapter serving the output of a SIMD engine one uint64_t at a time, for code written against scalar generators.
+//The engine refills an aligned block of outputs with its bulk fill(), so most calls are a load and an increment.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "bulk.h"
+#include "splitmix.h"
+
+namespace simdrand {
+
+//UniformRandomBitGenerator returning the outputs of Engine in the order fill() stores them, i.e. lane after lane of
+//consecutive next() results. Engine is any _2/_4/_8 engine or a dispatch engine; Size is the number of buffered outputs.
+template <typename Engine, size_t Size = 512>
+struct buffered {
+    static_assert(Size != 0 && Size % 8 == 0, "Size must be a whole number of next() results for every width");
+
+    using result_type = uint64_t;
+
+    //simdrand::fill_u32() splits the buffered outputs like the wrapped engine's own.
+    static constexpr bool high_half_first = detail::high_half_first<Engine>::value;
+
+    explicit buffered(const Engine& engine) noexcept
+        : m_engine(engine)
+        , m_position(Size)
+    {
+    }
+
+    explicit buffered(splitmix::splitmix64 gen) noexcept
+        : m_engine(gen)
+        , m_position(Size)
+    {
+    }
+
+    //Smallest value operator() can return.
+    static constexpr result_type min() noexcept { return 0; }
+
+    //Largest value operator() can return.
+    static constexpr result_type max() noexcept { return UINT64_MAX; }
+
+    //Returns the next buffered output, refilling the buffer when it runs out.
+    result_type operator()() noexcept
+    {
+        if (__builtin_expect(m_position == Size, 0))
+            refill();
+        return m_buffer[m_position++];
+    }
+
+    //Same as operator().
+    result_type next() noexcept { return (*this)(); }
+
+    //Wrapped engine, already advanced past the buffered outputs.
+    const Engine& engine() const noexcept { return m_engine; }
+
+    //Compares the outputs that remain to be returned and the states of the wrapped engines for equality.
+    bool operator==(const buffered& other) const noexcept
+    {
+        return m_position == other.m_position && m_engine == other.m_engine
+            && std::memcmp(m_buffer + m_position, other.m_buffer + m_position, (Size - m_position) * sizeof(uint64_t)) == 0;
+    }
+
+    //Compares the outputs that remain to be returned and the states of the wrapped engines for inequality.
+    bool operator!=(const buffered& other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+    //Kept out of line so operator() stays small enough to inline at every call site.
+    __attribute__((noinline)) void refill() noexcept
+    {
+        m_engine.fill(m_buffer, Size);
+        m_position = 0;
+    }
+
+    alignas(64) uint64_t m_buffer[Size];
+    Engine m_engine;
+    size_t m_position;
+};
+
+}
+
+#endif // BUFFERED_H_INCLUDED
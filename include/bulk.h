@@ -0,0 +1,235 @@
+#ifndef BULK_H_INCLUDED
+#define BULK_H_INCLUDED
+
+//Bulk generation helpers shared by all engines: write consecutive next() results straight into a caller-provided buffer.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "simd.h"
+
+namespace simdrand {
+
+//Buffers at least this large are written with non-temporal stores when the destination is suitably aligned,
+//as they would only evict useful data from the cache.
+constexpr size_t non_temporal_threshold = size_t(1) << 22;
+
+namespace detail {
+
+    //Number of outputs generated per iteration of the main bulk loop.
+    constexpr size_t unroll = 4;
+
+    //Stores v to possibly unaligned dst; compiles to a single (v)movdqu.
+    template <typename T>
+    inline void store(void* dst, const T& v) noexcept
+    {
+        std::memcpy(dst, &v, sizeof(T));
+    }
+
+#ifdef __SSE2__
+    //Non-temporal stores of a single output, dst must be aligned to its size.
+    //_mm_stream_si64() only exists on x86-64; i386 streams the two 32-bit halves.
+    inline void stream(void* dst, uint64_t v) noexcept
+    {
+#ifdef __x86_64__
+        _mm_stream_si64(static_cast<long long*>(dst), static_cast<long long>(v));
+#else
+        _mm_stream_si32(static_cast<int*>(dst), static_cast<int>(v));
+        _mm_stream_si32(static_cast<int*>(dst) + 1, static_cast<int>(v >> 32));
+#endif
+    }
+
+    inline void stream(void* dst, __m128i v) noexcept
+    {
+        _mm_stream_si128(static_cast<__m128i*>(dst), v);
+    }
+
+    inline void stream(void* dst, __m128d v) noexcept
+    {
+        _mm_stream_pd(static_cast<double*>(dst), v);
+    }
+
+    inline void stream(void* dst, __m128 v) noexcept
+    {
+        _mm_stream_ps(static_cast<float*>(dst), v);
+    }
+
+    //Orders the non-temporal stores before the stores that follow.
+    inline void store_fence() noexcept
+    {
+        _mm_sfence();
+    }
+#else
+    //Without non-temporal store intrinsics, as on AArch64, large buffers are written with ordinary stores.
+    template <typename T>
+    inline void stream(void* dst, const T& v) noexcept
+    {
+        store(dst, v);
+    }
+
+    inline void store_fence() noexcept
+    {
+    }
+#endif // __SSE2__
+
+#ifdef __AVX__
+    inline void stream(void* dst, __m256i v) noexcept
+    {
+        _mm256_stream_si256(static_cast<__m256i*>(dst), v);
+    }
+
+    inline void stream(void* dst, __m256d v) noexcept
+    {
+        _mm256_stream_pd(static_cast<double*>(dst), v);
+    }
+
+    inline void stream(void* dst, __m256 v) noexcept
+    {
+        _mm256_stream_ps(static_cast<float*>(dst), v);
+    }
+#endif // __AVX__
+
+#ifdef __AVX512F__
+    inline void stream(void* dst, __m512i v) noexcept
+    {
+        _mm512_stream_si512(static_cast<__m512i*>(dst), v);
+    }
+
+    inline void stream(void* dst, __m512d v) noexcept
+    {
+        _mm512_stream_pd(static_cast<double*>(dst), v);
+    }
+
+    inline void stream(void* dst, __m512 v) noexcept
+    {
+        _mm512_stream_ps(static_cast<float*>(dst), v);
+    }
+#endif // __AVX512F__
+
+    //Swaps the two 32-bit halves of every 64-bit lane of x.
+    inline uint64_t swap_halves(uint64_t x) noexcept
+    {
+        return x << 32 | x >> 32;
+    }
+
+#if defined SIMDRAND_NEON
+    inline uint64x2_t swap_halves(uint64x2_t x) noexcept
+    {
+        return vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(x)));
+    }
+#elif defined __SSE2__
+    inline __m128i swap_halves(__m128i x) noexcept
+    {
+        return _mm_shuffle_epi32(x, 0xb1);
+    }
+#endif // SIMDRAND_NEON
+
+#ifdef __AVX2__
+    inline __m256i swap_halves(__m256i x) noexcept
+    {
+        return _mm256_shuffle_epi32(x, 0xb1);
+    }
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+    inline __m512i swap_halves(__m512i x) noexcept
+    {
+        return _mm512_shuffle_epi32(x, _MM_PERM_CDAB);
+    }
+#endif // __AVX512F__
+
+    //Engine::high_half_first, false for engines that do not declare it.
+    template <typename Engine, typename = void>
+    struct high_half_first : std::false_type {
+    };
+
+    template <typename Engine>
+    struct high_half_first<Engine, decltype(void(Engine::high_half_first))> : std::integral_constant<bool, Engine::high_half_first> {
+    };
+
+    //Writes n bytes produced by consecutive calls of generate() to dst.
+    //generate() is called exactly ceil(n / sizeof(output)) times; only the surplus bytes of the last output are dropped.
+    template <typename Generate>
+    inline void generate_bytes(void* dst, size_t n, Generate&& generate) noexcept
+    {
+        using output_type = decltype(generate());
+        constexpr size_t size = sizeof(output_type);
+
+        unsigned char* out = static_cast<unsigned char*>(dst);
+        unsigned char* const last = out + n / (unroll * size) * (unroll * size);
+
+        if (n >= non_temporal_threshold && reinterpret_cast<uintptr_t>(out) % size == 0) {
+            for (; out != last; out += unroll * size) {
+                //Outputs are generated before being stored so the stores do not serialize with the state updates.
+                const output_type a = generate();
+                const output_type b = generate();
+                const output_type c = generate();
+                const output_type d = generate();
+                stream(out, a);
+                stream(out + size, b);
+                stream(out + 2 * size, c);
+                stream(out + 3 * size, d);
+            }
+            store_fence();
+        } else {
+            for (; out != last; out += unroll * size) {
+                const output_type a = generate();
+                const output_type b = generate();
+                const output_type c = generate();
+                const output_type d = generate();
+                store(out, a);
+                store(out + size, b);
+                store(out + 2 * size, c);
+                store(out + 3 * size, d);
+            }
+        }
+
+        n %= unroll * size;
+        for (; n >= size; n -= size, out += size)
+            store(out, generate());
+
+        if (n != 0) {
+            const output_type tail = generate();
+            std::memcpy(out, &tail, n);
+        }
+    }
+
+} // namespace detail
+
+//Fills n bytes at dst with the output of engine, as if consecutive next() results were stored one after another.
+template <typename Engine>
+inline void fill_bytes(Engine& engine, void* dst, size_t n) noexcept
+{
+    detail::generate_bytes(dst, n, [&engine]() noexcept { return engine.next(); });
+}
+
+//Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+template <typename Engine>
+inline void fill(Engine& engine, uint64_t* dst, size_t n) noexcept
+{
+    fill_bytes(engine, dst, n * sizeof(uint64_t));
+}
+
+//Returns next() split into 32-bit values, two per 64-bit lane, in the order they are stored to memory. The halves are
+//swapped for the engines declaring high_half_first, the + generators whose lowest output bits are weak, so that the
+//better high half comes first; for the others this is next() itself.
+template <typename Engine>
+inline auto next_u32(Engine& engine) noexcept -> decltype(engine.next())
+{
+    const auto x = engine.next();
+    return detail::high_half_first<Engine>::value ? detail::swap_halves(x) : x;
+}
+
+//Fills dst with n random uint32_t, as if consecutive next_u32() results were stored one after another.
+//Every 64-bit output gives two values; with n odd the second half of the last output is dropped.
+template <typename Engine>
+inline void fill_u32(Engine& engine, uint32_t* dst, size_t n) noexcept
+{
+    detail::generate_bytes(dst, n * sizeof(uint32_t), [&engine]() noexcept { return next_u32(engine); });
+}
+
+}
+
+#endif // BULK_H_INCLUDED
@@ -0,0 +1,368 @@
+#ifndef DISPATCH_H_INCLUDED
+#define DISPATCH_H_INCLUDED
+
+//Runtime CPU dispatch: one binary picks the widest kernel the CPU supports instead of relying on -mavx/-mavx2/-mavx512f.
+//Kernels are written once per algorithm over uint64_t and GCC vector extension types and compiled for every
+//instruction set through target attributes, so the engines below work regardless of the flags the caller was built with.
+//On AArch64, where NEON is part of the base architecture, the choice is between the scalar and the NEON kernel.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "bulk.h"
+#include "splitmix.h"
+
+namespace simdrand {
+
+//Instruction set levels the dispatched engines choose from. neon is only supported on AArch64, where it stands in for
+//every level above it; the x86-64 levels imply all previous ones except neon, which they run as scalar.
+enum class isa {
+    scalar,
+    neon,
+    avx,
+    avx2,
+    avx512
+};
+
+//Returns the widest instruction set supported by the CPU and the OS. CPUID is only queried on the first call.
+inline isa detected_isa() noexcept
+{
+#if defined __x86_64__ || defined __i386__
+    static const isa detected = []() noexcept {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return isa::avx512;
+        if (__builtin_cpu_supports("avx2"))
+            return isa::avx2;
+        if (__builtin_cpu_supports("avx"))
+            return isa::avx;
+        return isa::scalar;
+    }();
+    return detected;
+#elif defined SIMDRAND_NEON
+    return isa::neon;
+#else
+    return isa::scalar;
+#endif
+}
+
+namespace detail {
+
+    typedef uint64_t u64x2 __attribute__((vector_size(16)));
+    typedef uint64_t u64x4 __attribute__((vector_size(32)));
+    typedef uint64_t u64x8 __attribute__((vector_size(64)));
+
+#if defined __x86_64__ || defined __i386__
+    //Non-temporal store of one group of lanes, dst must be aligned to its size. Unlike the stream() overloads of bulk.h
+    //these do not depend on the compiler flags, only on the target of the kernel they are inlined into.
+    inline void stream_block(unsigned char* dst, uint64_t v) noexcept
+    {
+#ifdef __x86_64__
+        _mm_stream_si64(reinterpret_cast<long long*>(dst), static_cast<long long>(v));
+#else
+        _mm_stream_si32(reinterpret_cast<int*>(dst), static_cast<int>(v));
+        _mm_stream_si32(reinterpret_cast<int*>(dst) + 1, static_cast<int>(v >> 32));
+#endif
+    }
+
+    inline void stream_block(unsigned char* dst, u64x2 v) noexcept
+    {
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst), reinterpret_cast<__m128i>(v));
+    }
+
+    __attribute__((target("avx"))) inline void stream_block(unsigned char* dst, u64x4 v) noexcept
+    {
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst), reinterpret_cast<__m256i>(v));
+    }
+
+    __attribute__((target("avx512f"))) inline void stream_block(unsigned char* dst, u64x8 v) noexcept
+    {
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(dst), reinterpret_cast<__m512i>(v));
+    }
+#else
+    template <typename V>
+    inline void stream_block(unsigned char* dst, V v) noexcept
+    {
+        std::memcpy(dst, &v, sizeof(V));
+    }
+#endif
+
+    //Runs blocks steps of Kernel over state, storing Lanes outputs per step; with Stream, dst must be aligned to sizeof(V).
+    //The lanes are split into independent groups of V, which also gives the narrower widths some instruction level parallelism.
+    template <typename Kernel, typename V, bool Stream, size_t Lanes>
+    __attribute__((always_inline)) inline void run(uint64_t (&state)[Kernel::words][Lanes], unsigned char* dst, size_t blocks) noexcept
+    {
+        constexpr size_t width = sizeof(V) / sizeof(uint64_t);
+        constexpr size_t groups = Lanes / width;
+
+        V s[groups][Kernel::words];
+        for (size_t g = 0; g < groups; ++g)
+            for (size_t w = 0; w < Kernel::words; ++w)
+                std::memcpy(&s[g][w], &state[w][g * width], sizeof(V));
+
+        for (size_t i = 0; i < blocks; ++i) {
+            for (size_t g = 0; g < groups; ++g) {
+                V result;
+                Kernel::next(s[g], result);
+                if (Stream)
+                    stream_block(dst + g * sizeof(V), result);
+                else
+                    std::memcpy(dst + g * sizeof(V), &result, sizeof(V));
+            }
+            dst += Lanes * sizeof(uint64_t);
+            //Keeps GCC 12 from vectorizing this loop across blocks: with the state of the scalar kernel promoted to
+            //registers it does so wrongly, and the splitmix64 kernel at -O3 stored lanes 0..3 twice per step.
+            __asm__("");
+        }
+        if (Stream)
+            store_fence();
+
+        for (size_t g = 0; g < groups; ++g)
+            for (size_t w = 0; w < Kernel::words; ++w)
+                std::memcpy(&state[w][g * width], &s[g][w], sizeof(V));
+    }
+
+    template <typename Kernel, bool Stream, size_t Lanes>
+    void run_scalar(uint64_t (&state)[Kernel::words][Lanes], unsigned char* dst, size_t blocks) noexcept
+    {
+        run<Kernel, uint64_t, Stream>(state, dst, blocks);
+    }
+
+#if defined __x86_64__ || defined __i386__
+    template <typename Kernel, bool Stream, size_t Lanes>
+    __attribute__((target("avx"))) void run_avx(uint64_t (&state)[Kernel::words][Lanes], unsigned char* dst, size_t blocks) noexcept
+    {
+        run<Kernel, u64x2, Stream>(state, dst, blocks);
+    }
+
+    template <typename Kernel, bool Stream, size_t Lanes>
+    __attribute__((target("avx2"))) void run_avx2(uint64_t (&state)[Kernel::words][Lanes], unsigned char* dst, size_t blocks) noexcept
+    {
+        run<Kernel, u64x4, Stream>(state, dst, blocks);
+    }
+
+    template <typename Kernel, bool Stream, size_t Lanes>
+    __attribute__((target("avx512f"))) void run_avx512(uint64_t (&state)[Kernel::words][Lanes], unsigned char* dst, size_t blocks) noexcept
+    {
+        run<Kernel, u64x8, Stream>(state, dst, blocks);
+    }
+#elif defined SIMDRAND_NEON
+    template <typename Kernel, bool Stream, size_t Lanes>
+    void run_neon(uint64_t (&state)[Kernel::words][Lanes], unsigned char* dst, size_t blocks) noexcept
+    {
+        run<Kernel, u64x2, Stream>(state, dst, blocks);
+    }
+#endif
+
+    //Seeds state with Kernel::seed() for kernels that declare it, such as the splitmix64 one whose second word is an
+    //increment rather than random state.
+    template <typename Kernel, size_t Lanes>
+    inline auto seed(splitmix::splitmix64& gen, uint64_t (&state)[Kernel::words][Lanes], int) noexcept
+        -> decltype(Kernel::seed(gen, state))
+    {
+        Kernel::seed(gen, state);
+    }
+
+    //Otherwise lane i gets the state a scalar engine constructed from gen would get, after lanes 0..i-1 took theirs.
+    template <typename Kernel, size_t Lanes>
+    inline void seed(splitmix::splitmix64& gen, uint64_t (&state)[Kernel::words][Lanes], long) noexcept
+    {
+        for (size_t i = 0; i < Lanes; ++i)
+            for (size_t w = 0; w < Kernel::words; ++w)
+                state[w][i] = gen.next();
+    }
+
+} // namespace detail
+
+//Engine that runs Kernel on the widest instruction set available at runtime.
+//The state always holds dispatch::lanes independent lanes; a step produces one uint64_t per lane, stored in lane order.
+//The scalar, NEON, AVX, AVX-2 and AVX-512 kernels all produce the same stream for the same state.
+template <typename Kernel>
+struct dispatch {
+    static constexpr size_t lanes = 8;
+
+    //The 32-bit outputs come in the order of Kernel's, so buffered<dispatch> splits them like fill_u32() does.
+    static constexpr bool high_half_first = detail::high_half_first<Kernel>::value;
+
+    //Seeds lane i with the state a scalar engine constructed from gen would get, after lanes 0..i-1 took theirs,
+    //unless Kernel defines its own seeding.
+    explicit dispatch(splitmix::splitmix64 gen, isa requested = detected_isa()) noexcept
+    {
+        detail::seed<Kernel>(gen, m_state, 0);
+        select(requested);
+    }
+
+    //state[w][i] is the w-th state word of lane i.
+    explicit dispatch(const uint64_t (&state)[Kernel::words][lanes], isa requested = detected_isa()) noexcept
+    {
+        std::memcpy(m_state, state, sizeof(m_state));
+        select(requested);
+    }
+
+    //Instruction set of the kernel in use.
+    constexpr isa target() const noexcept { return m_isa; }
+
+    //Fills n bytes at dst with random data. The engine advances by whole steps of lanes outputs.
+    //Like the bulk fill() of the other engines, large 64-byte aligned buffers are written with non-temporal stores.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        constexpr size_t block = lanes * sizeof(uint64_t);
+        unsigned char* out = static_cast<unsigned char*>(dst);
+
+        if (n >= non_temporal_threshold && reinterpret_cast<uintptr_t>(out) % block == 0)
+            m_stream(m_state, out, n / block);
+        else
+            m_run(m_state, out, n / block);
+
+        if (n % block != 0) {
+            unsigned char tail[block];
+            m_run(m_state, tail, 1);
+            std::memcpy(out + n / block * block, tail, n % block);
+        }
+    }
+
+    //Fills dst with n random uint64_t.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        fill_bytes(dst, n * sizeof(uint64_t));
+    }
+
+    //Fills dst with n random uint32_t, the two 32-bit halves of every output in the order simdrand::next_u32() gives them.
+    //Without Kernel::high_half_first this is fill_bytes(); otherwise the halves are swapped chunk by chunk while the
+    //chunk is still in the cache, and large buffers are not written with non-temporal stores.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
+    {
+        if (!detail::high_half_first<Kernel>::value) {
+            fill_bytes(dst, n * sizeof(uint32_t));
+            return;
+        }
+
+        constexpr size_t block = lanes * 2;
+        constexpr size_t chunk = 64 * block;
+        unsigned char* out = reinterpret_cast<unsigned char*>(dst);
+
+        for (size_t left = n / block * block; left != 0;) {
+            const size_t count = left < chunk ? left : chunk;
+            m_run(m_state, out, count / block);
+            swap_halves(out, count / 2);
+            out += count * sizeof(uint32_t);
+            left -= count;
+        }
+
+        if (n % block != 0) {
+            unsigned char tail[block * sizeof(uint32_t)];
+            m_run(m_state, tail, 1);
+            swap_halves(tail, lanes);
+            std::memcpy(out, tail, n % block * sizeof(uint32_t));
+        }
+    }
+
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept
+    {
+        return hash_words(&m_state[0][0], Kernel::words * lanes);
+    }
+
+    //Compares internal states of two engines for equality.
+    bool operator==(const dispatch& other) const noexcept
+    {
+        return std::memcmp(m_state, other.m_state, sizeof(m_state)) == 0;
+    }
+
+    //Compares internal states of two engines for inequality.
+    bool operator!=(const dispatch& other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+    //Swaps the 32-bit halves of the words uint64_t at p, which need not be aligned.
+    static void swap_halves(unsigned char* p, size_t words) noexcept
+    {
+        for (size_t i = 0; i < words; ++i) {
+            uint64_t x;
+            std::memcpy(&x, p + i * sizeof(uint64_t), sizeof(uint64_t));
+            x = detail::swap_halves(x);
+            std::memcpy(p + i * sizeof(uint64_t), &x, sizeof(uint64_t));
+        }
+    }
+
+    using run_type = void (*)(uint64_t (&)[Kernel::words][lanes], unsigned char*, size_t);
+
+    //Picks the kernel for requested, lowered to what the CPU actually supports.
+    void select(isa requested) noexcept
+    {
+        m_isa = requested < detected_isa() ? requested : detected_isa();
+        switch (m_isa) {
+#if defined __x86_64__ || defined __i386__
+        case isa::avx512:
+            m_run = detail::run_avx512<Kernel, false, lanes>;
+            m_stream = detail::run_avx512<Kernel, true, lanes>;
+            break;
+        case isa::avx2:
+            m_run = detail::run_avx2<Kernel, false, lanes>;
+            m_stream = detail::run_avx2<Kernel, true, lanes>;
+            break;
+        case isa::avx:
+            m_run = detail::run_avx<Kernel, false, lanes>;
+            m_stream = detail::run_avx<Kernel, true, lanes>;
+            break;
+#elif defined SIMDRAND_NEON
+        case isa::neon:
+            m_run = detail::run_neon<Kernel, false, lanes>;
+            m_stream = detail::run_neon<Kernel, true, lanes>;
+            break;
+#endif
+        default:
+            m_isa = isa::scalar;
+            m_run = detail::run_scalar<Kernel, false, lanes>;
+            m_stream = detail::run_scalar<Kernel, true, lanes>;
+            break;
+        }
+    }
+
+    alignas(64) uint64_t m_state[Kernel::words][lanes];
+    run_type m_run;
+    run_type m_stream;
+    isa m_isa;
+};
+
+}
+
+//The splitmix64 kernel lives here rather than in splitmix.h, which dispatch.h itself includes for seeding.
+namespace splitmix {
+
+//splitmix64 step written once for uint64_t and vector extension types; instantiated for every width by dispatch.
+//Word 0 is the counter and word 1 the increment it adds per step, lanes times the golden gamma, so that the lanes
+//interleave into a single splitmix64 sequence.
+struct kernel {
+    static constexpr size_t words = 2;
+
+    //Lane i starts i steps after the state of gen, so fill() stores the sequence of gen itself.
+    template <size_t Lanes>
+    static void seed(splitmix64& gen, uint64_t (&state)[2][Lanes]) noexcept
+    {
+        for (size_t i = 0; i < Lanes; ++i) {
+            state[0][i] = uint64_t(gen) - (Lanes - 1 - i) * 0x9e3779b97f4a7c15;
+            state[1][i] = Lanes * 0x9e3779b97f4a7c15;
+        }
+    }
+
+    template <typename V>
+    static inline void next(V (&s)[2], V& result) noexcept
+    {
+        V z = s[0] += s[1];
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        result = z ^ (z >> 31);
+    }
+};
+
+//splitmix64 engine using the widest kernel supported by the CPU it runs on; fill() stores the same sequence as
+//splitmix64(gen).
+using dispatch = simdrand::dispatch<kernel>;
+
+}
+
+#endif // DISPATCH_H_INCLUDED
@@ -0,0 +1,147 @@
+#ifndef INTERLEAVED_H_INCLUDED
+#define INTERLEAVED_H_INCLUDED
+
+//Engine made of Depth independent copies of a SIMD engine, stepped one after another inside the bulk loop.
+//Each next() of an engine is a single dependency chain through its state; with several states in flight the chains
+//overlap and fill the vector ports a single engine leaves idle.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "bulk.h"
+#include "splitmix.h"
+
+namespace simdrand {
+
+//Output k of interleaved, counting next() results, is result k / Depth of engine k % Depth: fill() stores a next() of
+//engine 0, then of engine 1, ..., of engine Depth - 1, then again of engine 0, and next() returns them in the same order.
+//Engine is any _2/_4/_8 engine. Depth 2 to 4 is what the register files hold: AVX-2 has 16 registers, so 4 states of
+//a 4-word engine such as xoshiro256plusplus_4 already spill, while AVX-512 has 32. The narrow engines gain the most;
+//the _8 engines already keep the vector ports busy on their own.
+template <typename Engine, size_t Depth = 2>
+struct interleaved {
+    static_assert(Depth != 0, "Depth must be at least 1");
+
+    using result_type = decltype(std::declval<Engine&>().next());
+
+    //The 32-bit outputs come in the order of Engine's.
+    static constexpr bool high_half_first = detail::high_half_first<Engine>::value;
+
+    //Seeds engine d with splitmix64(s_d), s_d being output d of gen.
+    explicit interleaved(splitmix::splitmix64 gen) noexcept
+        : interleaved(gen, std::make_index_sequence<Depth>())
+    {
+    }
+
+    explicit interleaved(const Engine (&engines)[Depth]) noexcept
+        : interleaved(engines, std::make_index_sequence<Depth>())
+    {
+    }
+
+    //Generates the next result of the engine whose turn it is.
+    result_type next() noexcept
+    {
+        const result_type result = m_engines[m_turn].next();
+        m_turn = m_turn + 1 == Depth ? 0 : m_turn + 1;
+        return result;
+    }
+
+    //Engine d, already advanced past the outputs returned so far.
+    const Engine& engine(size_t d) const noexcept { return m_engines[d]; }
+
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        fill_bytes(dst, n * sizeof(uint64_t));
+    }
+
+    //Fills n bytes at dst with random data; the engines advance by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        constexpr size_t size = sizeof(result_type);
+        unsigned char* out = static_cast<unsigned char*>(dst);
+
+        //Finishes the round started by next() first, so the main loop steps every engine once per iteration.
+        for (; m_turn != 0 && n >= size; n -= size, out += size)
+            detail::store(out, next());
+
+        //The engines are stepped in a local copy, which the stores to out cannot alias, so their states stay in registers.
+        interleaved local(*this);
+        unsigned char* const last = out + n / (Depth * size) * (Depth * size);
+        if (n >= non_temporal_threshold && reinterpret_cast<uintptr_t>(out) % size == 0) {
+            for (; out != last; out += Depth * size)
+                local.template step<true>(out, std::make_index_sequence<Depth>());
+            detail::store_fence();
+        } else {
+            for (; out != last; out += Depth * size)
+                local.template step<false>(out, std::make_index_sequence<Depth>());
+        }
+        *this = local;
+
+        n %= Depth * size;
+        for (; n >= size; n -= size, out += size)
+            detail::store(out, next());
+
+        if (n != 0) {
+            const result_type tail = next();
+            std::memcpy(out, &tail, n);
+        }
+    }
+
+    //Compares the states of all engines and whose turn it is for equality.
+    bool operator==(const interleaved& other) const noexcept
+    {
+        for (size_t d = 0; d < Depth; ++d)
+            if (m_engines[d] != other.m_engines[d])
+                return false;
+        return m_turn == other.m_turn;
+    }
+
+    //Compares the states of all engines and whose turn it is for inequality.
+    bool operator!=(const interleaved& other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+    template <size_t... D>
+    interleaved(splitmix::splitmix64 gen, std::index_sequence<D...>) noexcept
+        : m_engines { Engine(splitmix::splitmix64(splitmix::at(static_cast<uint64_t>(gen), D)))... }
+        , m_turn(0)
+    {
+    }
+
+    template <size_t... D>
+    interleaved(const Engine (&engines)[Depth], std::index_sequence<D...>) noexcept
+        : m_engines { engines[D]... }
+        , m_turn(0)
+    {
+    }
+
+    //Steps every engine once and stores the results in engine order. The braced pack expansion is evaluated in order and
+    //unrolls the engines with no array of results in between, which at Depth 4 was spilled to the stack.
+    template <bool Stream, size_t... D>
+    __attribute__((always_inline)) inline void step(unsigned char* out, std::index_sequence<D...>) noexcept
+    {
+        const int expand[] = { (put<Stream>(out + D * sizeof(result_type), m_engines[D].next()), 0)... };
+        (void)expand;
+    }
+
+    template <bool Stream>
+    __attribute__((always_inline)) static inline void put(unsigned char* out, const result_type& result) noexcept
+    {
+        if (Stream)
+            detail::stream(out, result);
+        else
+            detail::store(out, result);
+    }
+
+    Engine m_engines[Depth];
+    size_t m_turn;
+};
+
+}
+
+#endif // INTERLEAVED_H_INCLUDED
@@ -0,0 +1,63 @@
+#ifndef MAPPED_FILE_H_INCLUDED
+#define MAPPED_FILE_H_INCLUDED
+
+//Random files generated in place: the file is mapped and parallel_fill() writes the mapped pages directly, with the
+//non-temporal stores of the bulk fill(), so there is no user buffer, no copy in write() and the caches are left alone.
+//POSIX only.
+
+#if defined __unix__ || defined __APPLE__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+namespace simdrand {
+
+//Creates or truncates the file at path and fills it with bytes random bytes: the leading bytes of the uint64_t
+//parallel_fill<Engine>() generates for seed, in host byte order, so the contents depend only on seed and bytes.
+//threads is passed on to parallel_fill(), whose threads fault in and stream whole 4 MiB chunks of pages. The pages
+//are flushed with msync() before returning. Returns false if the file cannot be created, sized, mapped or flushed.
+template <typename Engine = xorshift128plus::dispatch>
+bool fill_file(const char* path, size_t bytes, uint64_t seed, unsigned threads = 0) noexcept
+{
+    const int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    bool ok = ::ftruncate(fd, static_cast<off_t>(bytes)) == 0;
+    if (ok && bytes != 0) {
+        //Not MAP_POPULATE, which would fault in the whole file from this thread and keep it in memory at once. Each chunk
+        //is populated by the thread writing it instead, with a single call rather than a trap per page where Linux 5.14
+        //and later allow it; if that fails the stores fault the pages in. The chunks start on page boundaries, and the
+        //words past bytes fall in the rest of the last page, which is not part of the file.
+        void* const map = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ok = map != MAP_FAILED;
+        if (ok) {
+            const auto populate = [](uint64_t* chunk, size_t count) noexcept {
+#ifdef MADV_POPULATE_WRITE
+                ::madvise(chunk, count * sizeof(uint64_t), MADV_POPULATE_WRITE);
+#else
+                (void)chunk;
+                (void)count;
+#endif
+            };
+            parallel_fill<Engine>(static_cast<uint64_t*>(map), (bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), seed, threads, populate);
+            ok = ::msync(map, bytes, MS_SYNC) == 0;
+            ::munmap(map, bytes);
+        }
+    }
+
+    return ::close(fd) == 0 && ok;
+}
+
+}
+
+#endif // __unix__ || __APPLE__
+
+#endif // MAPPED_FILE_H_INCLUDED
@@ -0,0 +1,419 @@
+#ifndef NORMAL_H_INCLUDED
+#define NORMAL_H_INCLUDED
+
+//Normally distributed doubles and floats generated entirely in vector registers.
+//The default method is Marsaglia and Tsang's ziggurat (https://www.jstatsoft.org/v05/i08) with 256 layers: a lane costs one
+//random word, two table gathers and a compare, and about 1.5% of the lanes take the exact wedge or tail test.
+//The Box-Muller transform is provided as the fallback: no tables, no rejections and a fixed cost per output,
+//which is preferable on CPUs with slow gathers.
+//The math is written once over GCC vector extension types and instantiated for the 4 and 8 lane engines.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include "bulk.h"
+#include "dispatch.h"
+#include "simd.h"
+
+namespace simdrand {
+
+namespace detail {
+
+    //Ziggurat for the standard normal density: layer 0 is the base strip including the tail, layer 255 is the top one.
+    //A magnitude m < 2^52 drawn for layer i gives x = m * w[i]; it lies inside the curve whenever m < k[i].
+    struct ziggurat_table {
+        static constexpr double r = 3.6541528853610088;
+        static constexpr double area = 4.92867323399e-3;
+
+        double k[256];
+        double w[256];
+        double f[256];
+
+        ziggurat_table() noexcept
+        {
+            const double m = 4503599627370496.0;
+            double dn = r, tn = r;
+            const double q = area / std::exp(-0.5 * dn * dn);
+
+            k[0] = dn / q * m;
+            k[1] = 0.0;
+            w[0] = q / m;
+            w[255] = dn / m;
+            f[0] = 1.0;
+            f[255] = std::exp(-0.5 * dn * dn);
+
+            for (int i = 254; i >= 1; --i) {
+                dn = std::sqrt(-2.0 * std::log(area / dn + std::exp(-0.5 * dn * dn)));
+                k[i + 1] = dn / tn * m;
+                tn = dn;
+                f[i] = std::exp(-0.5 * dn * dn);
+                w[i] = dn / m;
+            }
+        }
+    };
+
+    //The tables are computed on first use, which takes a few microseconds.
+    inline const ziggurat_table& ziggurat() noexcept
+    {
+        static const ziggurat_table table;
+        return table;
+    }
+
+    //Integer vector types matching a double vector type, for bit manipulation and comparison results.
+    template <typename F>
+    struct float_vector;
+
+#ifdef __AVX2__
+
+    typedef double f64x4 __attribute__((vector_size(32)));
+    typedef int64_t i64x4 __attribute__((vector_size(32)));
+
+    template <>
+    struct float_vector<f64x4> {
+        typedef u64x4 unsigned_type;
+        typedef i64x4 signed_type;
+    };
+
+    inline f64x4 gather(const double* table, u64x4 index) noexcept { return _mm256_i64gather_pd(table, (__m256i)index, 8); }
+    inline f64x4 vector_sqrt(f64x4 x) noexcept { return _mm256_sqrt_pd(x); }
+    inline bool any(i64x4 mask) noexcept { return _mm256_movemask_pd((__m256d)mask) != 0; }
+    inline __m128 narrow(f64x4 x) noexcept { return _mm256_cvtpd_ps(x); }
+
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+
+    typedef double f64x8 __attribute__((vector_size(64)));
+    typedef int64_t i64x8 __attribute__((vector_size(64)));
+
+    template <>
+    struct float_vector<f64x8> {
+        typedef u64x8 unsigned_type;
+        typedef i64x8 signed_type;
+    };
+
+    inline f64x8 gather(const double* table, u64x8 index) noexcept { return _mm512_i64gather_pd((__m512i)index, table, 8); }
+    inline f64x8 vector_sqrt(f64x8 x) noexcept { return _mm512_sqrt_pd(x); }
+    inline bool any(i64x8 mask) noexcept { return _mm512_test_epi64_mask((__m512i)mask, (__m512i)mask) != 0; }
+    inline __m256 narrow(f64x8 x) noexcept { return _mm512_cvtpd_ps(x); }
+
+#endif // __AVX512F__
+
+    constexpr double _two_52 = 4503599627370496.0;
+    constexpr double _one_and_half_two_52 = 6755399441055744.0;
+    constexpr double _ln2_hi = 6.93147180369123816490e-01;
+    constexpr double _ln2_lo = 1.90821492927058770002e-10;
+
+    //Exact conversion of integers below 2^52 to double: x is placed in the mantissa of 2^52, which is then subtracted.
+    template <typename F, typename U>
+    inline F to_double52(U x) noexcept
+    {
+        return (F)(x | 0x4330000000000000) - _two_52;
+    }
+
+    //Exact conversion of signed integers with magnitude below 2^51 to double, through the mantissa of 1.5 * 2^52.
+    template <typename F, typename I>
+    inline F to_double51(I x) noexcept
+    {
+        return (F)(x + 0x4338000000000000) - _one_and_half_two_52;
+    }
+
+    //Double in [0, 1) from the top 52 bits of every lane of x.
+    template <typename F, typename U>
+    inline F closed_open(U x) noexcept
+    {
+        return to_double52<F>(x >> 12) * (1.0 / _two_52);
+    }
+
+    //Double in (0, 1] from the top 52 bits of every lane of x, safe to pass to vector_log.
+    template <typename F, typename U>
+    inline F open_closed(U x) noexcept
+    {
+        return 1.0 - closed_open<F>(x);
+    }
+
+    //Natural logarithm of positive normal doubles, accurate to a few ulp.
+    //x = 2^e * m with m in [sqrt(1/2), sqrt(2)), and log(m) = 2 * atanh((m - 1) / (m + 1)) is summed as a series.
+    template <typename F>
+    inline F vector_log(F x) noexcept
+    {
+        using U = typename float_vector<F>::unsigned_type;
+        using I = typename float_vector<F>::signed_type;
+
+        const U bits = (U)x;
+        F m = (F)((bits & 0x000fffffffffffff) | 0x3ff0000000000000);
+        I e = (I)(bits >> 52) - 1023;
+        const I big = m > 1.4142135623730951;
+        m = big ? m * 0.5 : m;
+        e -= big;
+
+        const F s = (m - 1.0) / (m + 1.0);
+        const F z = s * s;
+        F p = z * (1.0 / 21) + 1.0 / 19;
+        p = p * z + 1.0 / 17;
+        p = p * z + 1.0 / 15;
+        p = p * z + 1.0 / 13;
+        p = p * z + 1.0 / 11;
+        p = p * z + 1.0 / 9;
+        p = p * z + 1.0 / 7;
+        p = p * z + 1.0 / 5;
+        p = p * z + 1.0 / 3;
+        p = p * z + 1.0;
+
+        const F exponent = to_double51<F>(e);
+        return exponent * _ln2_hi + (2.0 * s * p + exponent * _ln2_lo);
+    }
+
+    //Exponential of doubles in [-708, 0], accurate to a few ulp.
+    //x = n * ln(2) + t with |t| <= ln(2) / 2; exp(t) is a Taylor polynomial and 2^n is built in the exponent field.
+    template <typename F>
+    inline F vector_exp(F x) noexcept
+    {
+        using U = typename float_vector<F>::unsigned_type;
+
+        const F rounded = x * 1.4426950408889634 + _one_and_half_two_52;
+        const F n = rounded - _one_and_half_two_52;
+        const F t = (x - n * _ln2_hi) - n * _ln2_lo;
+
+        F p = t * (1.0 / 6227020800) + 1.0 / 479001600;
+        p = p * t + 1.0 / 39916800;
+        p = p * t + 1.0 / 3628800;
+        p = p * t + 1.0 / 362880;
+        p = p * t + 1.0 / 40320;
+        p = p * t + 1.0 / 5040;
+        p = p * t + 1.0 / 720;
+        p = p * t + 1.0 / 120;
+        p = p * t + 1.0 / 24;
+        p = p * t + 1.0 / 6;
+        p = p * t + 0.5;
+        p = p * t + 1.0;
+        p = p * t + 1.0;
+
+        const U scale = ((U)rounded - 0x4338000000000000 + 1023) << 52;
+        return p * (F)scale;
+    }
+
+    //Sine and cosine of 2 * pi * x / 2^53 for x < 2^53.
+    //The reduction to the nearest quarter turn is exact because it is done on the integer x; the remaining angle is
+    //within [-pi/4, pi/4), where Taylor polynomials are accurate to an ulp.
+    template <typename F, typename U>
+    inline void sincos_turn(U x, F& sin, F& cos) noexcept
+    {
+        using I = typename float_vector<F>::signed_type;
+
+        const U quarter = (x + (UINT64_C(1) << 50)) >> 51;
+        const F angle = to_double51<F>((I)(x - (quarter << 51))) * (6.283185307179586 / 9007199254740992.0);
+        const F z = angle * angle;
+
+        F s = z * (-1.0 / 355687428096000) + 1.0 / 1307674368000;
+        s = s * z - 1.0 / 6227020800;
+        s = s * z + 1.0 / 39916800;
+        s = s * z - 1.0 / 362880;
+        s = s * z + 1.0 / 5040;
+        s = s * z - 1.0 / 120;
+        s = s * z + 1.0 / 6;
+        s = angle - angle * z * s;
+
+        F c = z * (1.0 / 20922789888000) - 1.0 / 87178291200;
+        c = c * z + 1.0 / 479001600;
+        c = c * z - 1.0 / 3628800;
+        c = c * z + 1.0 / 40320;
+        c = c * z - 1.0 / 720;
+        c = c * z + 1.0 / 24;
+        c = c * z - 0.5;
+        c = c * z + 1.0;
+
+        //Rotating by quarter turns swaps sine and cosine on odd quarters and flips their signs.
+        const I odd = (I)((quarter & 1) != 0);
+        sin = (F)((U)(odd ? c : s) ^ ((quarter & 2) << 62));
+        cos = (F)((U)(odd ? s : c) ^ (((quarter + 1) & 2) << 62));
+    }
+
+    //Candidate of the ziggurat fast path from one random word per lane: bits 0-7 pick the layer, bit 8 is the sign and the
+    //top 52 bits are the magnitude. Returns the mask of the lanes that are accepted without further tests.
+    template <typename F, typename U>
+    inline typename float_vector<F>::signed_type ziggurat_candidate(U bits, const ziggurat_table& table, U& layer, F& x) noexcept
+    {
+        const F magnitude = to_double52<F>(bits >> 12);
+        layer = bits & 0xff;
+        x = (F)((U)(magnitude * gather(table.w, layer)) | ((bits & 0x100) << 55));
+        return magnitude < gather(table.k, layer);
+    }
+
+    //Finishes the lanes of x that missed the ziggurat fast path by running the exact tests of the reference algorithm
+    //side by side, drawing the extra random words they need from further next() calls. Kept out of line as only about
+    //one vector in nine of 8 lanes, and one in seventeen of 4 lanes, gets here.
+    template <typename F, typename Engine>
+    __attribute__((noinline)) F ziggurat_slow(Engine& engine, const ziggurat_table& table, typename float_vector<F>::signed_type pending, typename float_vector<F>::unsigned_type layer, F x) noexcept
+    {
+        using U = typename float_vector<F>::unsigned_type;
+        using I = typename float_vector<F>::signed_type;
+
+        F result = x;
+        do {
+            //Base strip outside the rectangle: sample the tail beyond r with Marsaglia's exponential rejection.
+            const I tail = pending & (I)(layer == 0);
+            if (any(tail)) {
+                I todo = tail;
+                do {
+                    const F a = -vector_log(open_closed<F>((U)engine.next())) * (1.0 / ziggurat_table::r);
+                    const F b = -vector_log(open_closed<F>((U)engine.next()));
+                    const I accepted = todo & (b + b > a * a);
+                    result = accepted ? (F)((U)(ziggurat_table::r + a) | ((U)x & 0x8000000000000000)) : result;
+                    todo &= ~accepted;
+                } while (any(todo));
+                pending &= ~tail;
+            }
+
+            //Wedge between the rectangle and the curve: accept if a uniform height falls below the density.
+            if (any(pending)) {
+                const F u = closed_open<F>((U)engine.next());
+                const F lower = gather(table.f, layer);
+                const F upper = gather(table.f, (layer - 1) & 0xff);
+                const I accepted = pending & (lower + u * (upper - lower) < vector_exp(-0.5 * x * x));
+                result = accepted ? x : result;
+                pending &= ~accepted;
+            }
+
+            //Rejected lanes start over with a new candidate.
+            if (any(pending)) {
+                U next_layer;
+                F next_x;
+                const I fast = ziggurat_candidate((U)engine.next(), table, next_layer, next_x);
+                layer = pending ? next_layer : layer;
+                x = pending ? next_x : x;
+                result = (pending & fast) ? next_x : result;
+                pending &= ~fast;
+            }
+        } while (any(pending));
+
+        return result;
+    }
+
+    //Vector of independent standard normal doubles with the ziggurat method.
+    template <typename F, typename Engine>
+    inline F ziggurat_normal(Engine& engine, const ziggurat_table& table) noexcept
+    {
+        using U = typename float_vector<F>::unsigned_type;
+        using I = typename float_vector<F>::signed_type;
+
+        U layer;
+        F x;
+        const I pending = ~ziggurat_candidate((U)engine.next(), table, layer, x);
+        if (__builtin_expect(any(pending), 0))
+            return ziggurat_slow(engine, table, pending, layer, x);
+        return x;
+    }
+
+    //Two vectors of independent standard normal doubles from two next() calls with the Box-Muller transform.
+    template <typename F, typename Engine>
+    inline F box_muller_normal(Engine& engine, F& second) noexcept
+    {
+        using U = typename float_vector<F>::unsigned_type;
+
+        const F radius = vector_sqrt(-2.0 * vector_log(open_closed<F>((U)engine.next())));
+        F sin, cos;
+        sincos_turn((U)engine.next() >> 11, sin, cos);
+        second = radius * sin;
+        return radius * cos;
+    }
+
+    //Double vector type with as many lanes as Engine::next() returns.
+    template <size_t Bytes>
+    struct double_vector;
+
+#ifdef __AVX2__
+    template <>
+    struct double_vector<32> {
+        typedef f64x4 type;
+    };
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+    template <>
+    struct double_vector<64> {
+        typedef f64x8 type;
+    };
+#endif // __AVX512F__
+
+    template <typename Engine>
+    using normal_vector = typename double_vector<sizeof(std::declval<Engine&>().next())>::type;
+
+    template <typename F>
+    inline F convert(F x, const double*) noexcept { return x; }
+
+    template <typename F>
+    inline auto convert(F x, const float*) noexcept -> decltype(narrow(x)) { return narrow(x); }
+
+    template <typename Engine, typename T>
+    inline void fill_normal(Engine& engine, T* dst, size_t n, double mean, double stddev) noexcept
+    {
+        using F = normal_vector<Engine>;
+        const ziggurat_table& table = ziggurat();
+        generate_bytes(dst, n * sizeof(T), [&]() noexcept {
+            return convert(ziggurat_normal<F>(engine, table) * stddev + mean, dst);
+        });
+    }
+
+    template <typename Engine, typename T>
+    inline void fill_normal_box_muller(Engine& engine, T* dst, size_t n, double mean, double stddev) noexcept
+    {
+        using F = normal_vector<Engine>;
+        F second{};
+        bool pending = false;
+        generate_bytes(dst, n * sizeof(T), [&]() noexcept {
+            const F result = pending ? second : box_muller_normal(engine, second);
+            pending = !pending;
+            return convert(result * stddev + mean, dst);
+        });
+    }
+
+} // namespace detail
+
+#ifdef __AVX2__
+
+//Generates a vector of independent standard normal doubles, one per lane of next(), with the ziggurat method.
+template <typename Engine>
+inline detail::normal_vector<Engine> next_normal(Engine& engine) noexcept
+{
+    return detail::ziggurat_normal<detail::normal_vector<Engine>>(engine, detail::ziggurat());
+}
+
+//Fills dst with n normal doubles with the given mean and standard deviation, using the ziggurat method.
+//The output is the same as consecutive next_normal() results, scaled and stored one after another.
+template <typename Engine>
+inline void fill_normal(Engine& engine, double* dst, size_t n, double mean = 0.0, double stddev = 1.0) noexcept
+{
+    detail::fill_normal(engine, dst, n, mean, stddev);
+}
+
+//Fills dst with n normal floats with the given mean and standard deviation, rounded from the doubles fill_normal() generates.
+template <typename Engine>
+inline void fill_normal(Engine& engine, float* dst, size_t n, float mean = 0.0f, float stddev = 1.0f) noexcept
+{
+    detail::fill_normal(engine, dst, n, mean, stddev);
+}
+
+//Fills dst with n normal doubles with the given mean and standard deviation, using the Box-Muller transform.
+//Every two next() calls give two vectors: the cosine outputs are stored first, then the sine outputs.
+template <typename Engine>
+inline void fill_normal_box_muller(Engine& engine, double* dst, size_t n, double mean = 0.0, double stddev = 1.0) noexcept
+{
+    detail::fill_normal_box_muller(engine, dst, n, mean, stddev);
+}
+
+//Fills dst with n normal floats with the given mean and standard deviation, rounded from the doubles fill_normal_box_muller() generates.
+template <typename Engine>
+inline void fill_normal_box_muller(Engine& engine, float* dst, size_t n, float mean = 0.0f, float stddev = 1.0f) noexcept
+{
+    detail::fill_normal_box_muller(engine, dst, n, mean, stddev);
+}
+
+#endif // __AVX2__
+
+}
+
+#endif // NORMAL_H_INCLUDED
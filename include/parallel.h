@@ -0,0 +1,92 @@
+#ifndef PARALLEL_H_INCLUDED
+#define PARALLEL_H_INCLUDED
+
+//Multithreaded bulk generation for buffers too large for a single core to fill at memory bandwidth.
+//The buffer is cut into chunks of parallel_chunk outputs and chunk c is generated by its own engine, seeded from output c
+//of splitmix64(seed). Which thread generates which chunk does not matter, so the result depends only on the seed and n.
+//Seeding from the counter rather than jumping one engine ahead chunk by chunk positions any chunk in O(1), where
+//reaching chunk c by jump() would take c jumps, and works for engines that have no jump() at all.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "bulk.h"
+#include "splitmix.h"
+#include "xorshift128plus.h"
+
+namespace simdrand {
+
+//Outputs generated by one engine in parallel_fill: 4 MiB, so the bulk fill() of the SIMD engines uses non-temporal
+//stores and seeding is negligible, while a 1 GiB buffer still spreads over a few dozen threads.
+//Part of the definition of the parallel_fill stream, changing it changes the output.
+constexpr size_t parallel_chunk = non_temporal_threshold / sizeof(uint64_t);
+
+//Engine generating chunk c of the parallel_fill stream of seed: its first parallel_chunk outputs are outputs
+//c * parallel_chunk onwards, so the stream can also be produced chunk by chunk, for instance as it is being written out.
+template <typename Engine = xorshift128plus::dispatch>
+Engine chunk_engine(uint64_t seed, size_t c) noexcept
+{
+    return Engine(splitmix::splitmix64(splitmix::at(seed, c)));
+}
+
+namespace detail {
+
+    //Generates the chunks of dst claimed from next until none are left, calling prepare() on each one first.
+    template <typename Engine, typename Prepare>
+    void fill_chunks(std::atomic<size_t>& next, uint64_t* dst, size_t n, uint64_t seed, const Prepare& prepare) noexcept
+    {
+        const size_t chunks = (n + parallel_chunk - 1) / parallel_chunk;
+        for (size_t c = next.fetch_add(1, std::memory_order_relaxed); c < chunks; c = next.fetch_add(1, std::memory_order_relaxed)) {
+            Engine engine = chunk_engine<Engine>(seed, c);
+            const size_t first = c * parallel_chunk;
+            const size_t count = std::min(parallel_chunk, n - first);
+            prepare(dst + first, count);
+            engine.fill(dst + first, count);
+        }
+    }
+
+} // namespace detail
+
+//Fills dst with n random uint64_t using threads threads, the calling one included; 0 uses one per hardware thread.
+//Engine is any engine constructible from splitmix::splitmix64 with a fill(uint64_t*, size_t) member.
+//The output is the same for every thread count and schedule. If threads cannot be started, the ones running finish the work.
+//prepare(chunk, count) runs in the thread generating the count outputs at chunk right before it does, for per-chunk setup
+//such as faulting in the pages of a mapping from the thread that writes them.
+template <typename Engine = xorshift128plus::dispatch, typename Prepare>
+void parallel_fill(uint64_t* dst, size_t n, uint64_t seed, unsigned threads, const Prepare& prepare) noexcept
+{
+    if (threads == 0)
+        threads = std::max(1U, std::thread::hardware_concurrency());
+
+    const size_t chunks = (n + parallel_chunk - 1) / parallel_chunk;
+    const size_t helpers = std::min<size_t>(threads, chunks) - (chunks != 0);
+
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    try {
+        workers.reserve(helpers);
+        for (size_t i = 0; i < helpers; ++i)
+            workers.emplace_back(detail::fill_chunks<Engine, Prepare>, std::ref(next), dst, n, seed, std::cref(prepare));
+    } catch (const std::exception&) {
+    }
+
+    detail::fill_chunks<Engine>(next, dst, n, seed, prepare);
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+template <typename Engine = xorshift128plus::dispatch>
+void parallel_fill(uint64_t* dst, size_t n, uint64_t seed, unsigned threads = 0) noexcept
+{
+    parallel_fill<Engine>(dst, n, seed, threads, [](uint64_t*, size_t) noexcept {});
+}
+
+}
+
+#endif // PARALLEL_H_INCLUDED
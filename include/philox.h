@@ -0,0 +1,394 @@
+#ifndef PHILOX_H_INCLUDED
+#define PHILOX_H_INCLUDED
+
+//Reference implementation: Random123, https://github.com/DEShawResearch/random123 (philox4x32 with 10 rounds)
+//Salmon, Moraes, Dror, Shaw, "Parallel Random Numbers: As Easy as 1, 2, 3", SC'11.
+
+//Philox is counter-based: output block c of a stream is a bijection of the 128-bit counter c keyed by the 64-bit key,
+//so streams are selected by key and positioned by counter without jump polynomials.
+//Block c gives the two uint64_t x0 | x1 << 32 and x2 | x3 << 32 of its 32-bit words x0..x3, and every width generates
+//the same sequence for the same key and counter: next() of the _N engines returns N / 2 consecutive blocks in order.
+//A snapshot of any width is the single stream as the words {key, counter_low, counter_high, pending}, pending being 1
+//when the scalar engine has the second half of block counter - 1 left, so one taken between blocks restores into every width.
+
+#include <cstdint>
+#include <cstring>
+
+#include "bulk.h"
+#include "simd.h"
+#include "splitmix.h"
+#include "state.h"
+#include "uniform.h"
+
+namespace philox {
+
+//Round multipliers and Weyl key increments.
+constexpr uint32_t _m0 = 0xD2511F53;
+constexpr uint32_t _m1 = 0xCD9E8D57;
+constexpr uint32_t _w0 = 0x9E3779B9;
+constexpr uint32_t _w1 = 0xBB67AE85;
+constexpr int _rounds = 10;
+
+//The vector engines keep one block per pair of 64-bit lanes, as {x0 | x1 << 32, x2 | x3 << 32}. A round is then
+//mul32() of x0 and x2, reverse32() of the products and a three-input xor, at every width.
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+
+//philox4x32-10 implementation generating Width / 2 consecutive blocks per call: __m128i_u (uint64x2_t on AArch64),
+//__m256i_u or __m512i_u.
+template <size_t Width>
+struct philox4x32_10_n {
+    using ops = simdrand::simd<Width>;
+    using vector_type = typename ops::type;
+
+    explicit philox4x32_10_n(uint64_t key, uint64_t counter_low = 0, uint64_t counter_high = 0) noexcept
+    {
+        m_key = pairs(key & 0xffffffff, key >> 32);
+        set_counter(counter_low, counter_high);
+    }
+
+    explicit philox4x32_10_n(splitmix::splitmix64 gen) noexcept
+        : philox4x32_10_n(gen.next())
+    {
+    }
+
+    //Generates Width random uint64_t, Width / 2 consecutive blocks.
+    vector_type next() noexcept
+    {
+        const vector_type multiplier = pairs(_m0, _m1);
+        const vector_type increment = pairs(_w0, _w1);
+
+        vector_type x = m_counter;
+        vector_type key = m_key;
+        for (int r = 0; r < _rounds; ++r) {
+            if (r != 0)
+                key = ops::add32(key, increment);
+            x = ops::xor3(ops::reverse32(ops::mul32(x, multiplier)), ops::template shr<32>(x), key);
+        }
+
+        m_counter = ops::add128(m_counter, Width / 2);
+        return x;
+    }
+
+    //Makes the next call of next() return the Width / 2 blocks from counter_high << 64 | counter_low on.
+    void set_counter(uint64_t counter_low, uint64_t counter_high = 0) noexcept
+    {
+        uint64_t lanes[Width];
+        for (size_t i = 0; i < Width / 2; ++i) {
+            lanes[2 * i] = counter_low + i;
+            lanes[2 * i + 1] = counter_high + (lanes[2 * i] < counter_low);
+        }
+        m_counter = ops::load(lanes);
+    }
+
+    //Skips blocks blocks, equivalent to blocks / (Width / 2) calls of next().
+    void skip(uint64_t blocks) noexcept
+    {
+        m_counter = ops::add128(m_counter, blocks);
+    }
+
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        simdrand::fill(*this, dst, n);
+    }
+
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        simdrand::fill_bytes(*this, dst, n);
+    }
+
+    //Generates 2 * Width random uint32_t, the 32-bit halves of every lane of next() in the order fill_u32() stores them.
+    vector_type next_u32() noexcept
+    {
+        return simdrand::next_u32(*this);
+    }
+
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
+    {
+        simdrand::fill_u32(*this, dst, n);
+    }
+
+    //Generates Width doubles uniformly distributed in [0, 1), (x >> 11) * 2^-53 for every lane x of next().
+    typename ops::double_type next_double() noexcept
+    {
+        return simdrand::to_double(next());
+    }
+
+    //Generates 2 * Width floats uniformly distributed in [0, 1), taken from both 32-bit halves of every lane of next().
+    typename ops::float_type next_float() noexcept
+    {
+        return simdrand::to_float(next());
+    }
+
+    //Fills dst with n doubles in [0, 1), as if consecutive next_double() results were stored one after another.
+    void fill_uniform(double* dst, size_t n) noexcept
+    {
+        simdrand::fill_uniform(*this, dst, n);
+    }
+
+    //Fills dst with n floats in [0, 1), as if consecutive next_float() results were stored one after another.
+    void fill_uniform(float* dst, size_t n) noexcept
+    {
+        simdrand::fill_uniform(*this, dst, n);
+    }
+
+    //Key selecting the stream.
+    uint64_t key() const noexcept { return lane(m_key, 0) | lane(m_key, 1) << 32; }
+
+    //Low 64 bits of the counter of the first block the next call of next() returns.
+    uint64_t counter_low() const noexcept { return lane(m_counter, 0); }
+
+    //High 64 bits of the counter of the first block the next call of next() returns.
+    uint64_t counter_high() const noexcept { return lane(m_counter, 1); }
+
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(4, 1);
+
+    //Writes a snapshot of the stream to dst, state_size bytes in the format of every philox4x32-10 width.
+    void save_state(unsigned char* dst) const noexcept
+    {
+        const uint64_t state[4] = { key(), counter_low(), counter_high(), 0 };
+        simdrand::detail::save_state<4, 1>(dst, simdrand::engine_id::philox4x32_10, state);
+    }
+
+    //Restores a snapshot of a philox4x32-10 engine of any width taken between blocks.
+    //Returns false and leaves the engine unchanged if src holds another engine or half a block is pending.
+    bool load_state(const unsigned char* src) noexcept
+    {
+        uint64_t state[4];
+        if (!simdrand::detail::load_state<4, 1>(src, simdrand::engine_id::philox4x32_10, state) || state[3] != 0)
+            return false;
+
+        *this = philox4x32_10_n(state[0], state[1], state[2]);
+        return true;
+    }
+
+    //Hash of the key and counter for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept
+    {
+        const vector_type words[2] = { m_counter, m_key };
+        return simdrand::hash_state<Width>(words);
+    }
+
+    //Compares keys and counters of two engines for equality.
+    bool operator==(const philox4x32_10_n& other) const noexcept
+    {
+        const vector_type a[2] = { m_counter, m_key };
+        const vector_type b[2] = { other.m_counter, other.m_key };
+        return simdrand::all_equal<Width>(a, b);
+    }
+
+    //Compares keys and counters of two engines for inequality.
+    bool operator!=(const philox4x32_10_n& other) const noexcept
+    {
+        return !(*this == other);
+    }
+
+private:
+    //Vector whose even lanes are lo and odd lanes hi.
+    static inline vector_type pairs(uint64_t lo, uint64_t hi) noexcept
+    {
+        uint64_t lanes[Width];
+        for (size_t i = 0; i < Width; i += 2) {
+            lanes[i] = lo;
+            lanes[i + 1] = hi;
+        }
+        return ops::load(lanes);
+    }
+
+    static inline uint64_t lane(const vector_type& v, size_t i) noexcept
+    {
+        uint64_t lanes[Width];
+        std::memcpy(lanes, &v, sizeof(lanes));
+        return lanes[i];
+    }
+
+    vector_type m_counter;
+    vector_type m_key;
+};
+
+using philox4x32_10_2 = philox4x32_10_n<2>;
+
+#ifdef __AVX2__
+using philox4x32_10_4 = philox4x32_10_n<4>;
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+using philox4x32_10_8 = philox4x32_10_n<8>;
+#endif // __AVX512F__
+
+#endif // __AVX__ || SIMDRAND_NEON
+
+//philox4x32-10 implementation used to generate random uint64_t, one block every two calls of next().
+struct philox4x32_10 {
+    using result_type = uint64_t;
+
+    explicit constexpr philox4x32_10(uint64_t key, uint64_t counter_low = 0, uint64_t counter_high = 0) noexcept
+        : m_counter { counter_low, counter_high }
+        , m_key(key)
+        , m_second(0)
+        , m_pending(false)
+    {
+    }
+
+    explicit philox4x32_10(splitmix::splitmix64 gen) noexcept
+        : philox4x32_10(gen.next())
+    {
+    }
+
+    //Generates random uint64_t.
+    constexpr uint64_t next() noexcept
+    {
+        if (m_pending) {
+            m_pending = false;
+            return m_second;
+        }
+
+        uint64_t out[2] = {};
+        block(m_counter[0], m_counter[1], out);
+        m_counter[1] += ++m_counter[0] == 0;
+        m_second = out[1];
+        m_pending = true;
+        return out[0];
+    }
+
+    //Smallest value next() can return.
+    static constexpr result_type min() noexcept { return 0; }
+
+    //Largest value next() can return.
+    static constexpr result_type max() noexcept { return UINT64_MAX; }
+
+    //Same as next(); makes the engine a UniformRandomBitGenerator usable with std::shuffle and the <random> distributions.
+    constexpr result_type operator()() noexcept { return next(); }
+
+    //Makes the next call of next() return the first half of block counter_high << 64 | counter_low.
+    constexpr void set_counter(uint64_t counter_low, uint64_t counter_high = 0) noexcept
+    {
+        m_counter[0] = counter_low;
+        m_counter[1] = counter_high;
+        m_pending = false;
+    }
+
+    //Skips blocks blocks, equivalent to 2 * blocks calls of next().
+    constexpr void skip(uint64_t blocks) noexcept
+    {
+        m_counter[0] += blocks;
+        m_counter[1] += m_counter[0] < blocks;
+        if (m_pending) {
+            uint64_t out[2] = {};
+            block(m_counter[0] - 1, m_counter[1] - (m_counter[0] == 0), out);
+            m_second = out[1];
+        }
+    }
+
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        simdrand::fill(*this, dst, n);
+    }
+
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        simdrand::fill_bytes(*this, dst, n);
+    }
+
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
+    {
+        simdrand::fill_u32(*this, dst, n);
+    }
+
+    //Key selecting the stream.
+    constexpr uint64_t key() const noexcept { return m_key; }
+
+    //Low 64 bits of the counter of the next block next() computes, one past the block whose second half is pending.
+    constexpr uint64_t counter_low() const noexcept { return m_counter[0]; }
+
+    //High 64 bits of the counter of the next block next() computes.
+    constexpr uint64_t counter_high() const noexcept { return m_counter[1]; }
+
+    //Whether the next call of next() returns the second half of the previous block.
+    constexpr bool pending() const noexcept { return m_pending; }
+
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(4, 1);
+
+    //Writes a snapshot of the stream to dst, state_size bytes in the format of every philox4x32-10 width.
+    void save_state(unsigned char* dst) const noexcept
+    {
+        const uint64_t state[4] = { m_key, m_counter[0], m_counter[1], m_pending };
+        simdrand::detail::save_state<4, 1>(dst, simdrand::engine_id::philox4x32_10, state);
+    }
+
+    //Restores a snapshot of a philox4x32-10 engine of any width; the pending half of a block is computed again.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
+    {
+        uint64_t state[4];
+        if (!simdrand::detail::load_state<4, 1>(src, simdrand::engine_id::philox4x32_10, state) || state[3] > 1)
+            return false;
+
+        m_key = state[0];
+        set_counter(state[1], state[2]);
+        if (state[3] != 0) {
+            uint64_t out[2] = {};
+            block(m_counter[0] - 1, m_counter[1] - (m_counter[0] == 0), out);
+            m_second = out[1];
+            m_pending = true;
+        }
+        return true;
+    }
+
+    //Hash of the key, counter and pending flag for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept
+    {
+        const uint64_t words[4] = { m_key, m_counter[0], m_counter[1], m_pending };
+        return simdrand::hash_words(words, 4);
+    }
+
+    //Compares keys, counters and pending halves of blocks of two engines for equality.
+    constexpr bool operator==(const philox4x32_10& other) const noexcept
+    {
+        return m_key == other.m_key && m_counter[0] == other.m_counter[0] && m_counter[1] == other.m_counter[1]
+            && m_pending == other.m_pending && (!m_pending || m_second == other.m_second);
+    }
+
+    //Compares keys, counters and pending halves of blocks of two engines for inequality.
+    constexpr bool operator!=(const philox4x32_10& other) const noexcept { return !(*this == other); }
+
+private:
+    //Computes block counter_high << 64 | counter_low of the stream selected by m_key.
+    constexpr void block(uint64_t counter_low, uint64_t counter_high, uint64_t (&out)[2]) const noexcept
+    {
+        uint32_t x[4] = { uint32_t(counter_low), uint32_t(counter_low >> 32), uint32_t(counter_high), uint32_t(counter_high >> 32) };
+        uint32_t k0 = uint32_t(m_key), k1 = uint32_t(m_key >> 32);
+        for (int r = 0; r < _rounds; ++r) {
+            if (r != 0) {
+                k0 += _w0;
+                k1 += _w1;
+            }
+            const uint64_t p0 = uint64_t(_m0) * x[0];
+            const uint64_t p1 = uint64_t(_m1) * x[2];
+            const uint32_t x1 = x[1], x3 = x[3];
+            x[0] = uint32_t(p1 >> 32) ^ x1 ^ k0;
+            x[1] = uint32_t(p1);
+            x[2] = uint32_t(p0 >> 32) ^ x3 ^ k1;
+            x[3] = uint32_t(p0);
+        }
+        out[0] = x[0] | uint64_t(x[1]) << 32;
+        out[1] = x[2] | uint64_t(x[3]) << 32;
+    }
+
+    uint64_t m_counter[2];
+    uint64_t m_key;
+    uint64_t m_second;
+    bool m_pending;
+};
+
+}
+
+#endif // PHILOX_H_INCLUDED
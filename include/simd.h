@@ -0,0 +1,364 @@
+#ifndef SIMD_H_INCLUDED
+#define SIMD_H_INCLUDED
+
+//Portable vector operations the SIMD engines are written against, so each engine is a single template over the width:
+//simd<2> compiles to SSE/AVX on x86-64 and to NEON on AArch64, simd<4> to AVX-2 and simd<8> to AVX-512F, using the
+//AVX-512VL rotates and ternary logic when enabled. Lane i of a vector is the i-th uint64_t it stores to memory.
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined __aarch64__ && defined __ARM_NEON
+#include <arm_neon.h>
+//AArch64 always has NEON with 64-bit lanes and double precision, so the _2 engines need no compiler flags there.
+#define SIMDRAND_NEON 1
+#elif defined __x86_64__ || defined __i386__
+#include <immintrin.h>
+#endif
+
+namespace simdrand {
+
+//Operations on a vector of Width uint64_t lanes. set() takes the lanes highest first, like _mm_set_epi64x().
+//add32() adds the 32-bit words and mul32() multiplies the low 32-bit halves of the lanes into 64-bit products, like
+//_mm_mul_epu32(). The lanes 2i and 2i + 1 form 128-bit pairs: reverse32() reverses the four 32-bit words of every pair
+//and add128(x, n) adds n to every pair as a 128-bit integer, lane 2i holding its low 64 bits.
+template <size_t Width>
+struct simd;
+
+#if defined SIMDRAND_NEON
+
+template <>
+struct simd<2> {
+    using type = uint64x2_t;
+    using double_type = float64x2_t;
+    using float_type = float32x4_t;
+
+    static inline type set(uint64_t hi, uint64_t lo) noexcept { return vcombine_u64(vcreate_u64(lo), vcreate_u64(hi)); }
+
+    static inline type set1(uint64_t x) noexcept { return vdupq_n_u64(x); }
+
+    static inline type zero() noexcept { return vdupq_n_u64(0); }
+
+    static inline type load(const uint64_t* src) noexcept { return vld1q_u64(src); }
+
+    static inline type add(const type a, const type b) noexcept { return vaddq_u64(a, b); }
+
+    static inline type bit_or(const type a, const type b) noexcept { return vorrq_u64(a, b); }
+
+    static inline type bit_xor(const type a, const type b) noexcept { return veorq_u64(a, b); }
+
+    template <int k>
+    static inline type shl(const type x) noexcept { return vshlq_n_u64(x, k); }
+
+    template <int k>
+    static inline type shr(const type x) noexcept { return vshrq_n_u64(x, k); }
+
+    //Shift right and insert puts the high bits of x under the shifted low ones.
+    template <int k>
+    static inline type rotl(const type x) noexcept { return vsriq_n_u64(vshlq_n_u64(x, k), x, 64 - k); }
+
+    static inline type xor3(const type a, const type b, const type c) noexcept
+    {
+#ifdef __ARM_FEATURE_SHA3
+        return veor3q_u64(a, b, c);
+#else
+        return veorq_u64(a, veorq_u64(b, c));
+#endif
+    }
+
+    //Low 64 bits of x * y: lo(x) * lo(y) + ((hi(x) * lo(y) + lo(x) * hi(y)) << 32).
+    static inline type mullo(const type x, const type y) noexcept
+    {
+        const uint32x4_t cross = vmulq_u32(vreinterpretq_u32_u64(x), vrev64q_u32(vreinterpretq_u32_u64(y)));
+        return vmlal_u32(vshlq_n_u64(vpaddlq_u32(cross), 32), vmovn_u64(x), vmovn_u64(y));
+    }
+
+    static inline type add32(const type a, const type b) noexcept
+    {
+        return vreinterpretq_u64_u32(vaddq_u32(vreinterpretq_u32_u64(a), vreinterpretq_u32_u64(b)));
+    }
+
+    static inline type mul32(const type x, const type y) noexcept { return vmull_u32(vmovn_u64(x), vmovn_u64(y)); }
+
+    //Reverses the 32-bit words within each lane, then swaps the lanes.
+    static inline type reverse32(const type x) noexcept
+    {
+        const uint64x2_t r = vreinterpretq_u64_u32(vrev64q_u32(vreinterpretq_u32_u64(x)));
+        return vextq_u64(r, r, 1);
+    }
+
+    //The carry is the all-ones compare result, moved into the high lane and subtracted.
+    static inline type add128(const type x, uint64_t n) noexcept
+    {
+        const uint64x2_t increment = vcombine_u64(vcreate_u64(n), vcreate_u64(0));
+        const uint64x2_t sum = vaddq_u64(x, increment);
+        return vsubq_u64(sum, vextq_u64(vdupq_n_u64(0), vcltq_u64(sum, increment), 1));
+    }
+
+    static inline bool is_zero(const type x) noexcept { return vmaxvq_u32(vreinterpretq_u32_u64(x)) == 0; }
+
+    static inline bool equal(const type a, const type b) noexcept { return is_zero(veorq_u64(a, b)); }
+};
+
+#elif defined __SSE2__
+
+template <>
+struct simd<2> {
+    using type = __m128i_u;
+    using double_type = __m128d;
+    using float_type = __m128;
+
+    static inline type set(uint64_t hi, uint64_t lo) noexcept { return _mm_set_epi64x(hi, lo); }
+
+    static inline type set1(uint64_t x) noexcept { return _mm_set1_epi64x(x); }
+
+    static inline type zero() noexcept { return _mm_setzero_si128(); }
+
+    static inline type load(const uint64_t* src) noexcept { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)); }
+
+    static inline type add(const type a, const type b) noexcept { return _mm_add_epi64(a, b); }
+
+    static inline type bit_or(const type a, const type b) noexcept { return _mm_or_si128(a, b); }
+
+    static inline type bit_xor(const type a, const type b) noexcept { return _mm_xor_si128(a, b); }
+
+    template <int k>
+    static inline type shl(const type x) noexcept { return _mm_slli_epi64(x, k); }
+
+    template <int k>
+    static inline type shr(const type x) noexcept { return _mm_srli_epi64(x, k); }
+
+    template <int k>
+    static inline type rotl(const type x) noexcept
+    {
+#ifdef __AVX512VL__
+        return _mm_rol_epi64(x, k);
+#else
+        return _mm_or_si128(_mm_slli_epi64(x, k), _mm_srli_epi64(x, 64 - k));
+#endif
+    }
+
+    static inline type xor3(const type a, const type b, const type c) noexcept
+    {
+#ifdef __AVX512VL__
+        return _mm_ternarylogic_epi64(a, b, c, 0x96);
+#else
+        return _mm_xor_si128(a, _mm_xor_si128(b, c));
+#endif
+    }
+
+    //Low 64 bits of x * y; lo(x) * lo(y) + ((hi(x) * lo(y) + lo(x) * hi(y)) << 32) when 64-bit multiplication is not available.
+    static inline type mullo(const type x, const type y) noexcept
+    {
+#if defined __AVX512VL__ && defined __AVX512DQ__
+        return _mm_mullo_epi64(x, y);
+#else
+        const __m128i lo = _mm_mul_epu32(x, y);
+        const __m128i cross = _mm_add_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), y), _mm_mul_epu32(x, _mm_srli_epi64(y, 32)));
+        return _mm_add_epi64(lo, _mm_slli_epi64(cross, 32));
+#endif
+    }
+
+    static inline type add32(const type a, const type b) noexcept { return _mm_add_epi32(a, b); }
+
+    static inline type mul32(const type x, const type y) noexcept { return _mm_mul_epu32(x, y); }
+
+    static inline type reverse32(const type x) noexcept { return _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+    //Unsigned 64-bit compares need AVX-512VL and signed ones SSE4.2, so the carry out of the low lane is the top bit of
+    //(x & n) | ((x | n) & ~(x + n)).
+    static inline type add128(const type x, uint64_t n) noexcept
+    {
+        const __m128i increment = _mm_set_epi64x(0, n);
+        const __m128i sum = _mm_add_epi64(x, increment);
+        const __m128i carry = _mm_srli_epi64(_mm_or_si128(_mm_and_si128(x, increment), _mm_andnot_si128(sum, _mm_or_si128(x, increment))), 63);
+        return _mm_add_epi64(sum, _mm_slli_si128(carry, 8));
+    }
+
+    static inline bool is_zero(const type x) noexcept
+    {
+#ifdef __SSE4_1__
+        return _mm_testz_si128(x, x);
+#else
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_setzero_si128())) == 0xffff;
+#endif
+    }
+
+    static inline bool equal(const type a, const type b) noexcept { return is_zero(_mm_xor_si128(a, b)); }
+};
+
+#endif // SIMDRAND_NEON
+
+#ifdef __AVX2__
+
+template <>
+struct simd<4> {
+    using type = __m256i_u;
+    using double_type = __m256d;
+    using float_type = __m256;
+
+    static inline type set(uint64_t a, uint64_t b, uint64_t c, uint64_t d) noexcept { return _mm256_set_epi64x(a, b, c, d); }
+
+    static inline type set1(uint64_t x) noexcept { return _mm256_set1_epi64x(x); }
+
+    static inline type zero() noexcept { return _mm256_setzero_si256(); }
+
+    static inline type load(const uint64_t* src) noexcept { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)); }
+
+    static inline type add(const type a, const type b) noexcept { return _mm256_add_epi64(a, b); }
+
+    static inline type bit_or(const type a, const type b) noexcept { return _mm256_or_si256(a, b); }
+
+    static inline type bit_xor(const type a, const type b) noexcept { return _mm256_xor_si256(a, b); }
+
+    template <int k>
+    static inline type shl(const type x) noexcept { return _mm256_slli_epi64(x, k); }
+
+    template <int k>
+    static inline type shr(const type x) noexcept { return _mm256_srli_epi64(x, k); }
+
+    template <int k>
+    static inline type rotl(const type x) noexcept
+    {
+#ifdef __AVX512VL__
+        return _mm256_rol_epi64(x, k);
+#else
+        return _mm256_or_si256(_mm256_slli_epi64(x, k), _mm256_srli_epi64(x, 64 - k));
+#endif
+    }
+
+    static inline type xor3(const type a, const type b, const type c) noexcept
+    {
+#ifdef __AVX512VL__
+        return _mm256_ternarylogic_epi64(a, b, c, 0x96);
+#else
+        return _mm256_xor_si256(a, _mm256_xor_si256(b, c));
+#endif
+    }
+
+    static inline type mullo(const type x, const type y) noexcept
+    {
+#if defined __AVX512VL__ && defined __AVX512DQ__
+        return _mm256_mullo_epi64(x, y);
+#else
+        const __m256i lo = _mm256_mul_epu32(x, y);
+        const __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), y), _mm256_mul_epu32(x, _mm256_srli_epi64(y, 32)));
+        return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+#endif
+    }
+
+    static inline type add32(const type a, const type b) noexcept { return _mm256_add_epi32(a, b); }
+
+    static inline type mul32(const type x, const type y) noexcept { return _mm256_mul_epu32(x, y); }
+
+    static inline type reverse32(const type x) noexcept { return _mm256_shuffle_epi32(x, _MM_SHUFFLE(0, 1, 2, 3)); }
+
+    //The low lanes wrapped around where the sum is below the increment, compared as signed after flipping the sign bits.
+    static inline type add128(const type x, uint64_t n) noexcept
+    {
+        const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+        const __m256i increment = _mm256_set_epi64x(0, n, 0, n);
+        const __m256i sum = _mm256_add_epi64(x, increment);
+        const __m256i carry = _mm256_cmpgt_epi64(_mm256_xor_si256(increment, sign), _mm256_xor_si256(sum, sign));
+        return _mm256_sub_epi64(sum, _mm256_slli_si256(carry, 8));
+    }
+
+    static inline bool is_zero(const type x) noexcept { return _mm256_testz_si256(x, x); }
+
+    static inline bool equal(const type a, const type b) noexcept { return is_zero(_mm256_xor_si256(a, b)); }
+};
+
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+
+template <>
+struct simd<8> {
+    using type = __m512i_u;
+    using double_type = __m512d;
+    using float_type = __m512;
+
+    static inline type set(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t g, uint64_t h) noexcept
+    {
+        return _mm512_set_epi64(a, b, c, d, e, f, g, h);
+    }
+
+    static inline type set1(uint64_t x) noexcept { return _mm512_set1_epi64(x); }
+
+    static inline type zero() noexcept { return _mm512_setzero_si512(); }
+
+    static inline type load(const uint64_t* src) noexcept { return _mm512_loadu_si512(src); }
+
+    static inline type add(const type a, const type b) noexcept { return _mm512_add_epi64(a, b); }
+
+    static inline type bit_or(const type a, const type b) noexcept { return _mm512_or_si512(a, b); }
+
+    static inline type bit_xor(const type a, const type b) noexcept { return _mm512_xor_si512(a, b); }
+
+    template <int k>
+    static inline type shl(const type x) noexcept { return _mm512_slli_epi64(x, k); }
+
+    template <int k>
+    static inline type shr(const type x) noexcept { return _mm512_srli_epi64(x, k); }
+
+    template <int k>
+    static inline type rotl(const type x) noexcept { return _mm512_rol_epi64(x, k); }
+
+    static inline type xor3(const type a, const type b, const type c) noexcept { return _mm512_ternarylogic_epi64(a, b, c, 0x96); }
+
+    static inline type mullo(const type x, const type y) noexcept
+    {
+#ifdef __AVX512DQ__
+        return _mm512_mullo_epi64(x, y);
+#else
+        const __m512i lo = _mm512_mul_epu32(x, y);
+        const __m512i cross = _mm512_add_epi64(_mm512_mul_epu32(_mm512_srli_epi64(x, 32), y), _mm512_mul_epu32(x, _mm512_srli_epi64(y, 32)));
+        return _mm512_add_epi64(lo, _mm512_slli_epi64(cross, 32));
+#endif
+    }
+
+    static inline type add32(const type a, const type b) noexcept { return _mm512_add_epi32(a, b); }
+
+    static inline type mul32(const type x, const type y) noexcept { return _mm512_mul_epu32(x, y); }
+
+    static inline type reverse32(const type x) noexcept { return _mm512_shuffle_epi32(x, _MM_PERM_ABCD); }
+
+    static inline type add128(const type x, uint64_t n) noexcept
+    {
+        const __m512i increment = _mm512_set_epi64(0, n, 0, n, 0, n, 0, n);
+        const __m512i sum = _mm512_add_epi64(x, increment);
+        const __mmask8 carry = _mm512_cmplt_epu64_mask(sum, increment) & 0x55;
+        return _mm512_mask_add_epi64(sum, carry << 1, sum, _mm512_set1_epi64(1));
+    }
+
+    static inline bool is_zero(const type x) noexcept { return _mm512_test_epi64_mask(x, x) == 0; }
+
+    static inline bool equal(const type a, const type b) noexcept { return is_zero(_mm512_xor_si512(a, b)); }
+};
+
+#endif // __AVX512F__
+
+//Whether the arrays a and b of N vectors are equal. The differences of all words are or-ed together and tested once
+//(ptest, kortest or a horizontal maximum), so the comparison has no branch per word.
+template <size_t Width, size_t N>
+inline bool all_equal(const typename simd<Width>::type (&a)[N], const typename simd<Width>::type (&b)[N]) noexcept
+{
+    typename simd<Width>::type diff = simd<Width>::bit_xor(a[0], b[0]);
+    for (size_t i = 1; i < N; ++i)
+        diff = simd<Width>::bit_or(diff, simd<Width>::bit_xor(a[i], b[i]));
+    return simd<Width>::is_zero(diff);
+}
+
+//Vector whose lane i is the i-th of Width consecutive gen.next() results.
+template <size_t Width, typename Generator>
+inline typename simd<Width>::type draw(Generator& gen) noexcept
+{
+    uint64_t lanes[Width];
+    for (size_t i = 0; i < Width; ++i)
+        lanes[i] = gen.next();
+    return simd<Width>::load(lanes);
+}
+
+}
+
+#endif // SIMD_H_INCLUDED
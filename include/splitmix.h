@@ -3,174 +3,179 @@
 
 //Reference implementation: http://xoshiro.di.unimi.it/splitmix64.c
 
-#include <immintrin.h>
-#include <nmmintrin.h>
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 
-namespace splitmix {
+#include "bulk.h"
+#include "simd.h"
+#include "state.h"
+#include "uniform.h"
 
-//AVX512VL and AVX512DQ are required for _mm256_mullo_epi64() and _mm_mullo_epi64(), so not vectorizable only with AVX or AVX2.
-#if defined __AVX512VL__ && defined __AVX512DQ__
-#ifdef __AVX512F__
+namespace splitmix {
 
-const __m128i_u _add_avx = _mm_set1_epi64x(0x9e3779b97f4a7c15 * 2);
-const __m256i_u _add_avx2 = _mm256_set1_epi64x(0x9e3779b97f4a7c15 * 4);
-const __m512i_u _add_avx512 = _mm512_set1_epi64(0x9e3779b97f4a7c15 * 8);
+//64-bit vector multiplication (_mm_mullo_epi64() and friends) needs AVX512DQ and AVX512VL; without them it is emulated
+//with three 32-bit partial products (_mm_mul_epu32()), so the vectorized engines only need SSE4.1, AVX2 and AVX512F respectively.
 
-const __m128i_u _mul1_avx = _mm_set1_epi64x(0xbf58476d1ce4e5b9);
-const __m256i_u _mul1_avx2 = _mm256_set1_epi64x(0xbf58476d1ce4e5b9);
-const __m512i_u _mul1_avx512 = _mm512_set1_epi64(0xbf58476d1ce4e5b9);
+#if defined __SSE4_1__ || defined SIMDRAND_NEON
 
-const __m128i_u _mul2_avx = _mm_set1_epi64x(0x94d049bb133111eb);
-const __m256i_u _mul2_avx2 = _mm256_set1_epi64x(0x94d049bb133111eb);
-const __m512i_u _mul2_avx512 = _mm512_set1_epi64(0x94d049bb133111eb);
+//splitmix64 implementation generating Width lanes per call: __m128i_u with SSE4.1 or NEON (uint64x2_t on AArch64),
+//__m256i_u with AVX-2 or __m512i_u with AVX-512F.
+template <size_t Width>
+struct splitmix64_n {
+    using ops = simdrand::simd<Width>;
+    using vector_type = typename ops::type;
 
-//splitmix64 implementation using AVL-512F, AVX-512VL and AVX-512DQ sets to generate random __m512i_u.
-struct splitmix64_8 {
-    explicit splitmix64_8(__m512i_u state) noexcept
+    explicit splitmix64_n(vector_type state) noexcept
         : m_state(state)
     {
     }
 
-    splitmix64_8(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t g, uint64_t h) noexcept
+    //Takes the state of every lane as uint64_t, highest lane first like _mm_set_epi64x().
+    template <typename... Lanes, typename = typename std::enable_if<sizeof...(Lanes) == Width>::type>
+    splitmix64_n(Lanes... lanes) noexcept
     {
-        m_state = _mm512_set_epi64(a, b, c, d, e, f, g, h);
+        m_state = ops::set(static_cast<uint64_t>(lanes)...);
     }
 
-    explicit splitmix64_8(uint64_t a) noexcept
+    //Interleaves the lanes so that fill() stores the same sequence as splitmix64(a).
+    explicit splitmix64_n(uint64_t a) noexcept
     {
-        m_state = _mm512_set_epi64(a, a + 0x9e3779b97f4a7c15, a + 2 * 0x9e3779b97f4a7c15, a + 3 * 0x9e3779b97f4a7c15, a + 4 * 0x9e3779b97f4a7c15,
-            a + 5 * 0x9e3779b97f4a7c15, a + 6 * 0x9e3779b97f4a7c15, a + 7 * 0x9e3779b97f4a7c15);
+        uint64_t lanes[Width];
+        for (size_t i = 0; i < Width; ++i)
+            lanes[i] = a - (Width - 1 - i) * 0x9e3779b97f4a7c15;
+        m_state = ops::load(lanes);
     }
 
-    explicit constexpr operator __m512i_u() const noexcept { return m_state; }
+    explicit constexpr operator vector_type() const noexcept { return m_state; }
+
+    //Every lane adds Width increments per step, so a lane is not a splitmix64 stream and simdrand::split() rejects the engine.
+    static constexpr bool strided_lanes = true;
 
-    //Generates random __m512i_u.
-    __m512i_u next() noexcept
+    //Generates Width random uint64_t, one per lane.
+    vector_type next() noexcept
     {
-        __m512i_u z = m_state = _mm512_add_epi64(_add_avx512, m_state);
-        z = _mm512_mullo_epi64(_mul1_avx512, _mm512_xor_si512(z, _mm512_srli_epi64(z, 30)));
-        z = _mm512_mullo_epi64(_mul2_avx512, _mm512_xor_si512(z, _mm512_srli_epi64(z, 27)));
-        return _mm512_xor_si512(z, _mm512_srli_epi64(z, 31));
+        vector_type z = m_state = ops::add(ops::set1(0x9e3779b97f4a7c15 * Width), m_state);
+        z = ops::mullo(ops::set1(0xbf58476d1ce4e5b9), ops::bit_xor(z, ops::template shr<30>(z)));
+        z = ops::mullo(ops::set1(0x94d049bb133111eb), ops::bit_xor(z, ops::template shr<27>(z)));
+        return ops::bit_xor(z, ops::template shr<31>(z));
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const splitmix64_8& other) const noexcept
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
     {
-        __mmask8 cmp0 = _mm512_cmpeq_epi64_mask(other.m_state, m_state);
-        //TODO: proper fast implementation.
-        uint16_t mask0 = _mm_movemask_epi8(_mm_movm_epi64(cmp0));
-        return (mask0 == 0xffffU);
+        simdrand::fill(*this, dst, n);
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const splitmix64_8& other) const noexcept
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
     {
-        return !(*this == other);
+        simdrand::fill_bytes(*this, dst, n);
     }
 
-private:
-    __m512i_u m_state;
-};
-
-#endif // __AVX512F__
-
-//splitmix64 implementation using AVX-512VL and AVX-512DQ sets to generate random __m256i_u.
-struct splitmix64_4 {
-    explicit splitmix64_4(__m256i_u state) noexcept
-        : m_state(state)
+    //Generates 2 * Width random uint32_t, the 32-bit halves of every lane of next() in the order fill_u32() stores them.
+    vector_type next_u32() noexcept
     {
+        return simdrand::next_u32(*this);
     }
 
-    splitmix64_4(uint64_t a, uint64_t b, uint64_t c, uint64_t d) noexcept
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
     {
-        m_state = _mm256_set_epi64x(a, b, c, d);
+        simdrand::fill_u32(*this, dst, n);
     }
 
-    explicit splitmix64_4(uint64_t a) noexcept
+    //Generates Width doubles uniformly distributed in [0, 1), (x >> 11) * 2^-53 for every lane x of next().
+    typename ops::double_type next_double() noexcept
     {
-        m_state = _mm256_set_epi64x(a, a + 0x9e3779b97f4a7c15, a + 2 * 0x9e3779b97f4a7c15, a + 3 * 0x9e3779b97f4a7c15);
+        return simdrand::to_double(next());
     }
 
-    explicit constexpr operator __m256i_u() const noexcept { return m_state; }
-
-    //Generates random __m256i_u.
-    __m256i_u next() noexcept
+    //Generates 2 * Width floats uniformly distributed in [0, 1), taken from both 32-bit halves of every lane of next().
+    typename ops::float_type next_float() noexcept
     {
-        __m256i_u z = m_state = _mm256_add_epi64(_add_avx2, m_state);
-        z = _mm256_mullo_epi64(_mul1_avx2, _mm256_xor_si256(z, _mm256_srli_epi64(z, 30)));
-        z = _mm256_mullo_epi64(_mul2_avx2, _mm256_xor_si256(z, _mm256_srli_epi64(z, 27)));
-        return _mm256_xor_si256(z, _mm256_srli_epi64(z, 31));
+        return simdrand::to_float(next());
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const splitmix64_4& other) const noexcept
+    //Fills dst with n doubles in [0, 1), as if consecutive next_double() results were stored one after another.
+    void fill_uniform(double* dst, size_t n) noexcept
     {
-        __m256i_u cmp0 = _mm256_cmpeq_epi32(other.m_state, m_state);
-        unsigned mask0 = _mm256_movemask_epi8(cmp0);
-        return mask0 == 0xffffffffU;
+        simdrand::fill_uniform(*this, dst, n);
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const splitmix64_4& other) const noexcept
+    //Fills dst with n floats in [0, 1), as if consecutive next_float() results were stored one after another.
+    void fill_uniform(float* dst, size_t n) noexcept
     {
-        return !(*this == other);
+        simdrand::fill_uniform(*this, dst, n);
     }
 
-private:
-    __m256i_u m_state;
-};
+    using state_type = vector_type;
 
-//splitmix64 implementation using AVX-512VL and AVX-512DQ sets to generate random __m128i_u.
-struct splitmix64_2 {
-    explicit splitmix64_2(__m128i_u state) noexcept
-        : m_state(state)
-    {
-    }
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(1, Width);
 
-    splitmix64_2(uint64_t a, uint64_t b) noexcept
+    //Current state; lane i holds the state of the i-th interleaved stream.
+    constexpr const state_type& state() const noexcept { return m_state; }
+
+    //Writes a snapshot of every lane to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
     {
-        m_state = _mm_set_epi64x(a, b);
+        uint64_t lanes[Width];
+        std::memcpy(lanes, &m_state, sizeof(lanes));
+        simdrand::detail::save_state<1, Width>(dst, simdrand::engine_id::splitmix64, lanes);
     }
 
-    explicit splitmix64_2(uint64_t a) noexcept
+    //Restores a snapshot written by save_state() of an engine of the same algorithm and width.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
     {
-        m_state = _mm_set_epi64x(a, a + 0x9e3779b97f4a7c15);
-    }
+        uint64_t lanes[Width];
+        if (!simdrand::detail::load_state<1, Width>(src, simdrand::engine_id::splitmix64, lanes))
+            return false;
 
-    explicit constexpr operator __m128i_u() const noexcept { return m_state; }
+        std::memcpy(&m_state, lanes, sizeof(lanes));
+        return true;
+    }
 
-    //Generates random __m128i_u.
-    __m128i_u next() noexcept
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept
     {
-        __m128i_u z = m_state = _mm_add_epi64(_add_avx, m_state);
-        z = _mm_mullo_epi64(_mul1_avx, _mm_xor_si128(z, _mm_srli_epi64(z, 30)));
-        z = _mm_mullo_epi64(_mul2_avx, _mm_xor_si128(z, _mm_srli_epi64(z, 27)));
-        return _mm_xor_si128(z, _mm_srli_epi64(z, 31));
+        const vector_type words[1] = { m_state };
+        return simdrand::hash_state<Width>(words);
     }
 
     //Compares internal states of two engines for equality.
-    bool operator==(const splitmix64_2& other) const noexcept
+    bool operator==(const splitmix64_n& other) const noexcept
     {
-        __m128i_u cmp = _mm_cmpeq_epi8(m_state, other.m_state);
-        uint16_t test = _mm_movemask_epi8(cmp);
-        return test == 0xffffU;
+        return ops::equal(m_state, other.m_state);
     }
 
     //Compares internal states of two engines for inequality.
-    bool operator!=(const splitmix64_2& other) const noexcept
+    bool operator!=(const splitmix64_n& other) const noexcept
     {
         return !(*this == other);
     }
 
 private:
-    __m128i_u m_state;
+    vector_type m_state;
 };
 
-#endif // defined
+using splitmix64_2 = splitmix64_n<2>;
+
+#ifdef __AVX2__
+using splitmix64_4 = splitmix64_n<4>;
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+using splitmix64_8 = splitmix64_n<8>;
+#endif // __AVX512F__
+
+#endif // __SSE4_1__ || SIMDRAND_NEON
 
 //splitmix64 implementation used to generate random uint64_t.
 struct splitmix64 {
+    using result_type = uint64_t;
+
     splitmix64(uint64_t state) noexcept
         : m_state(state)
     {
@@ -187,6 +192,57 @@ struct splitmix64 {
         return z ^ (z >> 31);
     }
 
+    //Smallest value next() can return.
+    static constexpr result_type min() noexcept { return 0; }
+
+    //Largest value next() can return.
+    static constexpr result_type max() noexcept { return UINT64_MAX; }
+
+    //Same as next(); makes the engine a UniformRandomBitGenerator usable with std::shuffle and the <random> distributions.
+    constexpr result_type operator()() noexcept { return next(); }
+
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        simdrand::fill(*this, dst, n);
+    }
+
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        simdrand::fill_bytes(*this, dst, n);
+    }
+
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
+    {
+        simdrand::fill_u32(*this, dst, n);
+    }
+
+    using state_type = uint64_t;
+
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(1, 1);
+
+    //Current state; an engine constructed from it continues the sequence from here.
+    constexpr const state_type& state() const noexcept { return m_state; }
+
+    //Writes a snapshot of the state to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
+    {
+        simdrand::detail::save_state<1, 1>(dst, simdrand::engine_id::splitmix64, &m_state);
+    }
+
+    //Restores a snapshot written by save_state() of the same engine.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
+    {
+        return simdrand::detail::load_state<1, 1>(src, simdrand::engine_id::splitmix64, &m_state);
+    }
+
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept { return simdrand::hash_words(&m_state, 1); }
+
     //Compares internal states of two engines for equality.
     constexpr bool operator==(const splitmix64& other) const noexcept { return other.m_state == m_state; }
 
@@ -197,5 +253,33 @@ private:
     uint64_t m_state;
 };
 
+//Counter-based access: splitmix64(seed) returns mix(seed + (i + 1) * 0x9e3779b97f4a7c15) from its i-th call of next(),
+//so any output can be computed without generating the ones before it.
+
+//Returns output index of splitmix64(seed), counting from 0, in constant time.
+constexpr uint64_t at(uint64_t seed, uint64_t index) noexcept
+{
+    uint64_t z = seed + (index + 1) * 0x9e3779b97f4a7c15;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+//Fills dst with outputs first_index to first_index + n - 1 of splitmix64(seed), i.e. dst[i] = at(seed, first_index + i),
+//using the widest splitmix64 engine the compiler flags allow.
+inline void fill_range(uint64_t seed, uint64_t first_index, uint64_t* dst, size_t n) noexcept
+{
+    const uint64_t state = seed + first_index * 0x9e3779b97f4a7c15;
+#if defined __AVX512F__
+    splitmix64_8(state).fill(dst, n);
+#elif defined __AVX2__
+    splitmix64_4(state).fill(dst, n);
+#elif defined SIMDRAND_NEON
+    splitmix64_2(state).fill(dst, n);
+#else
+    splitmix64(state).fill(dst, n);
+#endif
+}
+
 }
 #endif // SPLITMIX_H_INCLUDED
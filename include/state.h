@@ -0,0 +1,206 @@
+#ifndef STATE_H_INCLUDED
+#define STATE_H_INCLUDED
+
+//Portable engine snapshots for checkpointing: save_state() writes the complete state of an engine in a few stores and
+//load_state() restores it, so the restored engine continues the sequence exactly where the saved one stopped.
+//
+//Format version 1 is an 8-byte header followed by the state words, everything little-endian whatever the host:
+//  byte 0-1  'S', 'R'
+//  byte 2    format version, 1
+//  byte 3    engine, an engine_id
+//  byte 4-5  lanes, number of independent streams
+//  byte 6-7  words, number of uint64_t of state per lane
+//then lanes * words uint64_t, lane after lane: the words of lane 0 in the order of the scalar engine's state, then
+//the words of lane 1, and so on. Lane i of a SIMD engine is the scalar engine fill() takes every Width-th output from,
+//except for splitmix64, whose lanes add Width increments per step.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "simd.h"
+
+namespace simdrand {
+
+//Algorithm stored in byte 3 of a snapshot. The values are part of the format and never change.
+enum class engine_id : uint8_t {
+    splitmix64 = 1,
+    xorshift64 = 2,
+    xorshift128plus = 3,
+    xoroshiro128plus = 4,
+    xoroshiro128plusplus = 5,
+    xoshiro256plusplus = 6,
+    xoshiro256ss = 7,
+    philox4x32_10 = 8
+};
+
+constexpr uint8_t state_version = 1;
+
+constexpr size_t state_header_size = 8;
+
+//Bytes written by save_state() of an engine with lanes lanes of words uint64_t each.
+constexpr size_t state_size(size_t words, size_t lanes) noexcept
+{
+    return state_header_size + words * lanes * sizeof(uint64_t);
+}
+
+namespace detail {
+
+    inline void store_le(unsigned char* dst, uint64_t x) noexcept
+    {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        x = __builtin_bswap64(x);
+#endif
+        std::memcpy(dst, &x, sizeof(x));
+    }
+
+    inline uint64_t load_le(const unsigned char* src) noexcept
+    {
+        uint64_t x;
+        std::memcpy(&x, src, sizeof(x));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        x = __builtin_bswap64(x);
+#endif
+        return x;
+    }
+
+    //Header of a snapshot as the uint64_t its 8 bytes hold in little-endian order.
+    constexpr uint64_t header(engine_id id, size_t words, size_t lanes) noexcept
+    {
+        return 'S' | uint64_t('R') << 8 | uint64_t(state_version) << 16 | uint64_t(id) << 24 | uint64_t(lanes) << 32
+            | uint64_t(words) << 48;
+    }
+
+    //Writes the snapshot of an engine with Lanes lanes of Words words, state[w * Lanes + i] being word w of lane i.
+    template <size_t Words, size_t Lanes>
+    inline void save_state(unsigned char* dst, engine_id id, const uint64_t* state) noexcept
+    {
+        store_le(dst, header(id, Words, Lanes));
+        dst += state_header_size;
+        for (size_t i = 0; i < Lanes; ++i)
+            for (size_t w = 0; w < Words; ++w, dst += sizeof(uint64_t))
+                store_le(dst, state[w * Lanes + i]);
+    }
+
+    //Reads a snapshot written by save_state() with the same id, Words and Lanes into state, laid out as above.
+    //Returns false without touching state if the header differs.
+    template <size_t Words, size_t Lanes>
+    inline bool load_state(const unsigned char* src, engine_id id, uint64_t* state) noexcept
+    {
+        if (load_le(src) != header(id, Words, Lanes))
+            return false;
+
+        src += state_header_size;
+        for (size_t i = 0; i < Lanes; ++i)
+            for (size_t w = 0; w < Words; ++w, src += sizeof(uint64_t))
+                state[w * Lanes + i] = load_le(src);
+        return true;
+    }
+
+    //Engine::strided_lanes, false for engines that do not declare it.
+    template <typename Engine, typename = void>
+    struct strided_lanes : std::false_type {
+    };
+
+    template <typename Engine>
+    struct strided_lanes<Engine, decltype(void(Engine::strided_lanes))> : std::integral_constant<bool, Engine::strided_lanes> {
+    };
+
+} // namespace detail
+
+//Hash of the n state words of an engine for hash tables, equal for equal states. Each word is xored into the running
+//value, which is multiplied and folded so the high bits the product changes reach the low ones before the next word,
+//and the splitmix64 finalizer mixes the result.
+inline uint64_t hash_words(const uint64_t* words, size_t n) noexcept
+{
+    uint64_t h = n;
+    for (size_t i = 0; i < n; ++i) {
+        h = (h ^ words[i]) * 0x9e3779b97f4a7c15;
+        h ^= h >> 32;
+    }
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111eb;
+    return h ^ (h >> 31);
+}
+
+//Hash of the state of a SIMD engine, one vector per word. The words of every lane are first folded into one vector
+//with rotates and xors, so only Width lanes go through the multiplies.
+template <size_t Width, size_t N>
+inline uint64_t hash_state(const typename simd<Width>::type (&words)[N]) noexcept
+{
+    typename simd<Width>::type folded = words[0];
+    for (size_t i = 1; i < N; ++i)
+        folded = simd<Width>::bit_xor(simd<Width>::template rotl<25>(folded), words[i]);
+
+    uint64_t lanes[Width];
+    std::memcpy(lanes, &folded, sizeof(lanes));
+    return hash_words(lanes, Width);
+}
+
+//Hash function object for unordered containers of engines, calling state_hash().
+struct state_hasher {
+    template <typename Engine>
+    size_t operator()(const Engine& engine) const noexcept
+    {
+        return static_cast<size_t>(engine.state_hash());
+    }
+};
+
+//Splits the lanes of from into Parts engines of To, the same algorithm with Parts times fewer lanes: part j takes lanes
+//j * L to j * L + L - 1, L being the lanes of To. Stepping the parts in turn, as simdrand::interleaved does, continues
+//the output stream of from exactly, so an _8 engine resumes as two _4 engines or eight scalar ones.
+//For philox4x32_10, whose widths all generate one stream, Parts is 1 and this converts between widths. The SIMD
+//splitmix64 engines step each lane by Width increments and cannot be split.
+//Returns false and leaves parts unchanged if To is another algorithm or cannot take the state.
+template <typename From, typename To, size_t Parts>
+inline bool split(const From& from, To (&parts)[Parts]) noexcept
+{
+    constexpr size_t part_size = To::state_size - state_header_size;
+    static_assert(From::state_size - state_header_size == Parts * part_size, "split must keep the total number of lanes");
+    static_assert(!detail::strided_lanes<From>::value, "the lanes of this engine depend on its width");
+
+    unsigned char whole[From::state_size];
+    from.save_state(whole);
+
+    //The header of a part is the one of from with the lanes, bytes 4 and 5, divided by Parts.
+    const uint64_t header = detail::load_le(whole);
+    const uint64_t lanes = header >> 32 & 0xffff;
+    unsigned char part[To::state_size];
+    detail::store_le(part, (header & ~(UINT64_C(0xffff) << 32)) | lanes / Parts << 32);
+
+    //All parts share the header, so either the first load fails or every one succeeds.
+    for (size_t j = 0; j < Parts; ++j) {
+        std::memcpy(part + state_header_size, whole + state_header_size + j * part_size, part_size);
+        if (!parts[j].load_state(part))
+            return false;
+    }
+    return true;
+}
+
+//Merges Parts engines into to, the inverse of split(): lanes of parts[j] become lanes j * L to j * L + L - 1 of to.
+//Returns false and leaves to unchanged if To is another algorithm or cannot take the state.
+template <typename From, size_t Parts, typename To>
+inline bool merge(const From (&parts)[Parts], To& to) noexcept
+{
+    constexpr size_t part_size = From::state_size - state_header_size;
+    static_assert(To::state_size - state_header_size == Parts * part_size, "merge must keep the total number of lanes");
+    static_assert(!detail::strided_lanes<To>::value, "the lanes of this engine depend on its width");
+
+    unsigned char whole[To::state_size];
+    unsigned char part[From::state_size];
+    for (size_t j = 0; j < Parts; ++j) {
+        parts[j].save_state(part);
+        std::memcpy(whole + state_header_size + j * part_size, part + state_header_size, part_size);
+    }
+
+    //Every part has the same header, with the lanes of From in bytes 4 and 5.
+    const uint64_t header = detail::load_le(part);
+    const uint64_t lanes = header >> 32 & 0xffff;
+    detail::store_le(whole, (header & ~(UINT64_C(0xffff) << 32)) | lanes * Parts << 32);
+    return to.load_state(whole);
+}
+
+}
+
+#endif // STATE_H_INCLUDED
@@ -0,0 +1,163 @@
+#ifndef UNIFORM_H_INCLUDED
+#define UNIFORM_H_INCLUDED
+
+//Conversion of random vectors to uniformly distributed floating-point numbers in [0, 1).
+//Every 64-bit lane x becomes the double (x >> 11) * 2^-53 and every 32-bit half u becomes the float (u >> 8) * 2^-24,
+//so the results are bit-identical to the usual scalar conversion, whichever instruction set is used.
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "bulk.h"
+#include "simd.h"
+
+namespace simdrand {
+
+constexpr double _double_unit = 1.0 / (UINT64_C(1) << 53);
+constexpr float _float_unit = 1.0f / (UINT32_C(1) << 24);
+
+//Converts x to a double in [0, 1) with 53 bits of precision.
+constexpr double to_double(uint64_t x) noexcept
+{
+    return (x >> 11) * _double_unit;
+}
+
+//Converts u to a float in [0, 1) with 24 bits of precision.
+constexpr float to_float(uint32_t u) noexcept
+{
+    return (u >> 8) * _float_unit;
+}
+
+#if defined SIMDRAND_NEON
+
+//Converts every 64-bit lane of x to a double in [0, 1) with 53 bits of precision.
+inline float64x2_t to_double(uint64x2_t x) noexcept
+{
+    return vmulq_n_f64(vcvtq_f64_u64(vshrq_n_u64(x, 11)), _double_unit);
+}
+
+//Converts both 32-bit halves of every 64-bit lane of x to floats in [0, 1) with 24 bits of precision, low half first.
+inline float32x4_t to_float(uint64x2_t x) noexcept
+{
+    return vmulq_n_f32(vcvtq_f32_u32(vshrq_n_u32(vreinterpretq_u32_u64(x), 8)), _float_unit);
+}
+
+#elif defined __SSE2__
+
+//Converts every 64-bit lane of x to a double in [0, 1) with 53 bits of precision.
+inline __m128d to_double(__m128i x) noexcept
+{
+    const __m128i v = _mm_srli_epi64(x, 11);
+#if defined __AVX512VL__ && defined __AVX512DQ__
+    return _mm_mul_pd(_mm_cvtepi64_pd(v), _mm_set1_pd(_double_unit));
+#else
+    //Both halves of v are converted exactly by placing them in the mantissas of 2^84 and 2^52, then recombined.
+    const __m128i lo = _mm_or_si128(_mm_and_si128(v, _mm_set1_epi64x(0xffffffff)), _mm_set1_epi64x(0x4330000000000000));
+    const __m128i hi = _mm_or_si128(_mm_srli_epi64(v, 32), _mm_set1_epi64x(0x4530000000000000));
+    const __m128d sum = _mm_add_pd(_mm_sub_pd(_mm_castsi128_pd(hi), _mm_set1_pd(19342813118337666422669312.0)), _mm_castsi128_pd(lo));
+    return _mm_mul_pd(sum, _mm_set1_pd(_double_unit));
+#endif
+}
+
+//Converts both 32-bit halves of every 64-bit lane of x to floats in [0, 1) with 24 bits of precision, low half first.
+inline __m128 to_float(__m128i x) noexcept
+{
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), _mm_set1_ps(_float_unit));
+}
+
+#endif // SIMDRAND_NEON
+
+#ifdef __AVX2__
+
+//Converts every 64-bit lane of x to a double in [0, 1) with 53 bits of precision.
+inline __m256d to_double(__m256i x) noexcept
+{
+    const __m256i v = _mm256_srli_epi64(x, 11);
+#if defined __AVX512VL__ && defined __AVX512DQ__
+    return _mm256_mul_pd(_mm256_cvtepi64_pd(v), _mm256_set1_pd(_double_unit));
+#else
+    //Both halves of v are converted exactly by placing them in the mantissas of 2^84 and 2^52, then recombined.
+    const __m256i lo = _mm256_blend_epi32(v, _mm256_set1_epi64x(0x4330000000000000), 0xaa);
+    const __m256i hi = _mm256_or_si256(_mm256_srli_epi64(v, 32), _mm256_set1_epi64x(0x4530000000000000));
+    const __m256d sum = _mm256_add_pd(_mm256_sub_pd(_mm256_castsi256_pd(hi), _mm256_set1_pd(19342813118337666422669312.0)), _mm256_castsi256_pd(lo));
+    return _mm256_mul_pd(sum, _mm256_set1_pd(_double_unit));
+#endif
+}
+
+//Converts both 32-bit halves of every 64-bit lane of x to floats in [0, 1) with 24 bits of precision, low half first.
+inline __m256 to_float(__m256i x) noexcept
+{
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(x, 8)), _mm256_set1_ps(_float_unit));
+}
+
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+
+//Converts every 64-bit lane of x to a double in [0, 1) with 53 bits of precision.
+inline __m512d to_double(__m512i x) noexcept
+{
+    const __m512i v = _mm512_srli_epi64(x, 11);
+#ifdef __AVX512DQ__
+    return _mm512_mul_pd(_mm512_cvtepi64_pd(v), _mm512_set1_pd(_double_unit));
+#else
+    //Both halves of v are converted exactly by placing them in the mantissas of 2^84 and 2^52, then recombined.
+    const __m512i lo = _mm512_mask_blend_epi32(0xaaaa, v, _mm512_set1_epi64(0x4330000000000000));
+    const __m512i hi = _mm512_or_si512(_mm512_srli_epi64(v, 32), _mm512_set1_epi64(0x4530000000000000));
+    const __m512d sum = _mm512_add_pd(_mm512_sub_pd(_mm512_castsi512_pd(hi), _mm512_set1_pd(19342813118337666422669312.0)), _mm512_castsi512_pd(lo));
+    return _mm512_mul_pd(sum, _mm512_set1_pd(_double_unit));
+#endif
+}
+
+//Converts both 32-bit halves of every 64-bit lane of x to floats in [0, 1) with 24 bits of precision, low half first.
+inline __m512 to_float(__m512i x) noexcept
+{
+    return _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(x, 8)), _mm512_set1_ps(_float_unit));
+}
+
+#endif // __AVX512F__
+
+//Fills dst with n doubles in [0, 1), as if consecutive engine.next_double() results were stored one after another.
+template <typename Engine>
+inline void fill_uniform(Engine& engine, double* dst, size_t n) noexcept
+{
+    detail::generate_bytes(dst, n * sizeof(double), [&engine]() noexcept { return to_double(engine.next()); });
+}
+
+namespace detail {
+
+    //Scalar engines: both 32-bit halves of every output, low half first like the vector conversions.
+    template <typename Engine>
+    inline void fill_uniform(Engine& engine, float* dst, size_t n, std::true_type) noexcept
+    {
+        for (; n >= 2; n -= 2, dst += 2) {
+            const uint64_t x = engine.next();
+            dst[0] = to_float(static_cast<uint32_t>(x));
+            dst[1] = to_float(static_cast<uint32_t>(x >> 32));
+        }
+
+        if (n != 0)
+            dst[0] = to_float(static_cast<uint32_t>(engine.next()));
+    }
+
+    template <typename Engine>
+    inline void fill_uniform(Engine& engine, float* dst, size_t n, std::false_type) noexcept
+    {
+        generate_bytes(dst, n * sizeof(float), [&engine]() noexcept { return to_float(engine.next()); });
+    }
+
+} // namespace detail
+
+//Fills dst with n floats in [0, 1), two from every 64-bit output: as if consecutive engine.next_float() results were
+//stored one after another, or for scalar engines the low and then the high half of every next().
+//The conversion only keeps the top 24 bits of every half, so the weak low bits of the + generators do not matter here.
+template <typename Engine>
+inline void fill_uniform(Engine& engine, float* dst, size_t n) noexcept
+{
+    detail::fill_uniform(engine, dst, n, std::integral_constant<bool, sizeof(engine.next()) == sizeof(uint64_t)>());
+}
+
+}
+
+#endif // UNIFORM_H_INCLUDED
@@ -2,195 +2,289 @@
 #define XOROSHIRO128PLUS_H_INCLUDED
 
 #include <cstdint>
-
+#include <cstring>
+#include <type_traits>
+
+#include "bounded.h"
+#include "bulk.h"
+#include "dispatch.h"
+#include "normal.h"
+#include "simd.h"
 #include "splitmix.h"
+#include "state.h"
+#include "uniform.h"
 
 namespace xoroshiro128plus {
 
-#ifdef __AVX__
+//Jump polynomials of the underlying linear engine: applying them advances the state by 2^64 and 2^96 steps.
+constexpr uint64_t _jump[2] = { 0xdf900294d8f554a5, 0x170865df4b3201fc };
+constexpr uint64_t _long_jump[2] = { 0xd2a98b26625eee7b, 0xdddf9b1090aa7ac1 };
+
+struct xoroshiro128plus;
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+
+//xoroshiro128+ implementation generating Width lanes per call: __m128i_u (uint64x2_t on AArch64), __m256i_u or __m512i_u.
+template <size_t Width>
+struct xoroshiro128plus_n {
+    using ops = simdrand::simd<Width>;
+    using vector_type = typename ops::type;
 
-//xoroshiro128+ implementation using AVX instruction set to generate random __m128i_u.
-struct xoroshiro128plus_2 {
-    xoroshiro128plus_2(__m128i_u a, __m128i_u b) noexcept
+    //The lowest bits of the sum are weak linear combinations of the state, so next_u32() and fill_u32() return the high
+    //half of every lane first.
+    static constexpr bool high_half_first = true;
+
+    xoroshiro128plus_n(vector_type a, vector_type b) noexcept
     {
         m_state[0] = a;
         m_state[1] = b;
     }
 
-    xoroshiro128plus_2(uint64_t a, uint64_t b, uint64_t c, uint64_t d) noexcept
+    template <size_t W = Width, typename = typename std::enable_if<W == 2>::type>
+    xoroshiro128plus_n(uint64_t a, uint64_t b, uint64_t c, uint64_t d) noexcept
     {
-        m_state[0] = _mm_set_epi64x(a, b);
-        m_state[1] = _mm_set_epi64x(c, d);
+        m_state[0] = ops::set(a, b);
+        m_state[1] = ops::set(c, d);
     }
 
-    explicit xoroshiro128plus_2(splitmix::splitmix64 gen) noexcept
+    explicit xoroshiro128plus_n(splitmix::splitmix64 gen) noexcept
     {
-        m_state[0] = _mm_set_epi64x(gen.next(), gen.next());
-        m_state[1] = _mm_set_epi64x(gen.next(), gen.next());
+        m_state[0] = simdrand::draw<Width>(gen);
+        m_state[1] = simdrand::draw<Width>(gen);
     }
 
-    //Generates random __m128i_u.
-    __m128i_u next() noexcept
+    //Seeds lane i with the state of base advanced by i jumps, so the lanes do not overlap for 2^64 outputs.
+    explicit xoroshiro128plus_n(xoroshiro128plus base) noexcept;
+
+    //Generates Width random uint64_t, one per lane.
+    vector_type next() noexcept
     {
-        const __m128i_u s0 = m_state[0];
-        __m128i_u s1 = m_state[1];
-        const __m128i_u result = _mm_add_epi64(s0, s1);
+        const vector_type s0 = m_state[0];
+        vector_type s1 = m_state[1];
+        const vector_type result = ops::add(s0, s1);
 
-        s1 = _mm_xor_si128(s1, s0);
-        m_state[0] = _mm_xor_si128(rotl(s0, 24), _mm_xor_si128(s1, _mm_slli_epi64(s1, 16)));
-        m_state[1] = rotl(s1, 37);
+        s1 = ops::bit_xor(s1, s0);
+        m_state[0] = ops::xor3(ops::template rotl<24>(s0), s1, ops::template shl<16>(s1));
+        m_state[1] = ops::template rotl<37>(s1);
 
         return result;
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const xoroshiro128plus_2& other) const noexcept
+    //Advances every lane by 2^64 steps, equivalent to 2^64 calls of next().
+    //Can be used to generate 2^64 non-overlapping subsequences for parallel computations.
+    void jump() noexcept
     {
-        __m128i_u cmp0 = _mm_cmpeq_epi32(other.m_state[0], m_state[0]);
-        __m128i_u cmp1 = _mm_cmpeq_epi32(other.m_state[1], m_state[1]);
-        uint16_t mask0 = _mm_movemask_epi8(cmp0);
-        uint16_t mask1 = _mm_movemask_epi8(cmp1);
-        return (mask0 == 0xffffU && mask1 == 0xffffU);
+        jump(_jump);
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const xoroshiro128plus_2& other) const noexcept
+    //Advances every lane by 2^96 steps, equivalent to 2^96 calls of next().
+    //Can be used to generate 2^32 starting points, from each of which jump() generates 2^32 non-overlapping subsequences.
+    void long_jump() noexcept
     {
-        return !(*this == other);
+        jump(_long_jump);
     }
 
-private:
-    static inline __m128i_u rotl(const __m128i_u x, int k) noexcept
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
     {
-        __m128i_u a = _mm_slli_epi64(x, k);
-        __m128i_u b = _mm_srli_epi64(x, 64 - k);
-        return _mm_or_si128(a, b);
+        simdrand::fill(*this, dst, n);
     }
 
-    __m128i_u m_state[2];
-};
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        simdrand::fill_bytes(*this, dst, n);
+    }
 
-#ifdef __AVX2__
+    //Generates 2 * Width random uint32_t, the 32-bit halves of every lane of next() in the order fill_u32() stores them.
+    vector_type next_u32() noexcept
+    {
+        return simdrand::next_u32(*this);
+    }
 
-struct xoroshiro128plus_4 {
-    xoroshiro128plus_4(__m256i_u a, __m256i_u b) noexcept
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
     {
-        m_state[0] = a;
-        m_state[1] = b;
+        simdrand::fill_u32(*this, dst, n);
     }
 
-    explicit xoroshiro128plus_4(splitmix::splitmix64 gen) noexcept
+    //Generates Width doubles uniformly distributed in [0, 1), (x >> 11) * 2^-53 for every lane x of next().
+    typename ops::double_type next_double() noexcept
     {
-        m_state[0] = _mm256_set_epi64x(gen.next(), gen.next(), gen.next(), gen.next());
-        m_state[1] = _mm256_set_epi64x(gen.next(), gen.next(), gen.next(), gen.next());
+        return simdrand::to_double(next());
     }
 
-    //Generates random __m256i_u.
-    __m256i_u next() noexcept
+    //Generates 2 * Width floats uniformly distributed in [0, 1), taken from both 32-bit halves of every lane of next().
+    typename ops::float_type next_float() noexcept
     {
-        const __m256i_u s0 = m_state[0];
-        __m256i_u s1 = m_state[1];
-        const __m256i_u result = _mm256_add_epi64(s0, s1);
+        return simdrand::to_float(next());
+    }
 
-        s1 = _mm256_xor_si256(s1, s0);
-        m_state[0] = _mm256_xor_si256(rotl(s0, 24), _mm256_xor_si256(s1, _mm256_slli_epi64(s1, 16)));
-        m_state[1] = rotl(s1, 37);
+    //Fills dst with n doubles in [0, 1), as if consecutive next_double() results were stored one after another.
+    void fill_uniform(double* dst, size_t n) noexcept
+    {
+        simdrand::fill_uniform(*this, dst, n);
+    }
 
-        return result;
+    //Fills dst with n floats in [0, 1), as if consecutive next_float() results were stored one after another.
+    void fill_uniform(float* dst, size_t n) noexcept
+    {
+        simdrand::fill_uniform(*this, dst, n);
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const xoroshiro128plus_4& other) const noexcept
+#ifdef __AVX2__
+    //The bounded integers and normal doubles only exist for 4 and 8 lanes.
+    //Generates 2 * Width independent 32-bit integers uniformly distributed in [0, range), range must not be 0.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    vector_type next_bounded(uint32_t range) noexcept
     {
-        __m256i_u cmp0 = _mm256_cmpeq_epi32(other.m_state[0], m_state[0]);
-        __m256i_u cmp1 = _mm256_cmpeq_epi32(other.m_state[1], m_state[1]);
-        uint32_t mask0 = _mm256_movemask_epi8(cmp0);
-        uint32_t mask1 = _mm256_movemask_epi8(cmp1);
-        return (mask0 == 0xffffffffU && mask1 == 0xffffffffU);
+        return simdrand::next_bounded(*this, range);
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const xoroshiro128plus_4& other) const noexcept
+    //Generates Width independent 64-bit integers uniformly distributed in [0, range), range must not be 0.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    vector_type next_bounded64(uint64_t range) noexcept
     {
-        return !(*this == other);
+        return simdrand::next_bounded64(*this, range);
     }
 
-private:
-    static inline __m256i_u rotl(const __m256i_u x, int k) noexcept
+    //Fills dst with n 32-bit integers uniformly distributed in [0, range), range must not be 0.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    void fill_bounded(uint32_t* dst, size_t n, uint32_t range) noexcept
     {
-        __m256i_u a = _mm256_slli_epi64(x, k);
-        __m256i_u b = _mm256_srli_epi64(x, 64 - k);
-        return _mm256_or_si256(a, b);
+        simdrand::fill_bounded(*this, dst, n, range);
     }
 
-    __m256i_u m_state[2];
-};
+    //Fills dst with n 64-bit integers uniformly distributed in [0, range), range must not be 0.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    void fill_bounded(uint64_t* dst, size_t n, uint64_t range) noexcept
+    {
+        simdrand::fill_bounded(*this, dst, n, range);
+    }
 
-#ifdef __AVX512F__
+    //Generates a vector of independent standard normal doubles with the ziggurat method.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    typename ops::double_type next_normal() noexcept
+    {
+        return simdrand::next_normal(*this);
+    }
 
-//xoroshiro128+ implementation using AVX512F instruction set to generate random __m512i_u.
-struct xoroshiro128plus_8 {
-    xoroshiro128plus_8(__m512i_u a, __m512i_u b) noexcept
+    //Fills dst with n normal doubles, as if consecutive next_normal() results were scaled by stddev, shifted by mean and stored.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    void fill_normal(double* dst, size_t n, double mean = 0.0, double stddev = 1.0) noexcept
     {
-        m_state[0] = a;
-        m_state[1] = b;
+        simdrand::fill_normal(*this, dst, n, mean, stddev);
+    }
+
+    //Fills dst with n normal floats, rounded from the doubles fill_normal() generates.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    void fill_normal(float* dst, size_t n, float mean = 0.0f, float stddev = 1.0f) noexcept
+    {
+        simdrand::fill_normal(*this, dst, n, mean, stddev);
     }
 
-    explicit xoroshiro128plus_8(splitmix::splitmix64 gen) noexcept
+    //Fills dst with n normal doubles with the Box-Muller transform, which needs no table lookups.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    void fill_normal_box_muller(double* dst, size_t n, double mean = 0.0, double stddev = 1.0) noexcept
     {
-        m_state[0] = _mm512_set_epi64(gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next());
-        m_state[1] = _mm512_set_epi64(gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next());
+        simdrand::fill_normal_box_muller(*this, dst, n, mean, stddev);
     }
 
-    //Generates random __m512i_u.
-    __m512i_u next() noexcept
+    //Fills dst with n normal floats, rounded from the doubles fill_normal_box_muller() generates.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    void fill_normal_box_muller(float* dst, size_t n, float mean = 0.0f, float stddev = 1.0f) noexcept
     {
-        const __m512i_u s0 = m_state[0];
-        __m512i_u s1 = m_state[1];
-        const __m512i_u result = _mm512_add_epi64(s0, s1);
+        simdrand::fill_normal_box_muller(*this, dst, n, mean, stddev);
+    }
+#endif // __AVX2__
 
-        s1 = _mm512_xor_si512(s1, s0);
-        m_state[0] = _mm512_xor_si512(rotl(s0, 24), _mm512_xor_si512(s1, _mm512_slli_epi64(s1, 16)));
-        m_state[1] = rotl(s1, 37);
+    using state_type = vector_type[2];
 
-        return result;
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(2, Width);
+
+    //Current state, one vector per state word; lane i holds the state of the i-th interleaved stream.
+    constexpr const state_type& state() const noexcept { return m_state; }
+
+    //Writes a snapshot of every lane to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
+    {
+        uint64_t lanes[2 * Width];
+        std::memcpy(lanes, &m_state, sizeof(lanes));
+        simdrand::detail::save_state<2, Width>(dst, simdrand::engine_id::xoroshiro128plus, lanes);
+    }
+
+    //Restores a snapshot written by save_state() of an engine of the same algorithm and width.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
+    {
+        uint64_t lanes[2 * Width];
+        if (!simdrand::detail::load_state<2, Width>(src, simdrand::engine_id::xoroshiro128plus, lanes))
+            return false;
+
+        std::memcpy(&m_state, lanes, sizeof(lanes));
+        return true;
+    }
+
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept
+    {
+        return simdrand::hash_state<Width>(m_state);
     }
 
     //Compares internal states of two engines for equality.
-    bool operator==(const xoroshiro128plus_8& other) const noexcept
+    bool operator==(const xoroshiro128plus_n& other) const noexcept
     {
-        __mmask8 cmp0 = _mm512_cmpeq_epi64_mask(other.m_state[0], m_state[0]);
-        __mmask8 cmp1 = _mm512_cmpeq_epi64_mask(other.m_state[1], m_state[1]);
-        //TODO: proper fast implementation.
-        uint16_t mask0 = _mm_movemask_epi8(_mm_movm_epi64(cmp0));
-        uint16_t mask1 = _mm_movemask_epi8(_mm_movm_epi64(cmp1));
-        return (mask0 == 0xffffU && mask1 == 0xffffU);
+        return simdrand::all_equal<Width>(m_state, other.m_state);
     }
 
     //Compares internal states of two engines for inequality.
-    bool operator!=(const xoroshiro128plus_8& other) const noexcept
+    bool operator!=(const xoroshiro128plus_n& other) const noexcept
     {
         return !(*this == other);
     }
 
 private:
-    static inline __m512i_u rotl(const __m512i_u x, int k) noexcept
+    //Advances every lane by the number of steps encoded in polynomial.
+    void jump(const uint64_t (&polynomial)[2]) noexcept
     {
-        __m512i_u a = _mm512_slli_epi64(x, k);
-        __m512i_u b = _mm512_srli_epi64(x, 64 - k);
-        return _mm512_or_si512(a, b);
+        vector_type s[2];
+        for (size_t w = 0; w < 2; ++w)
+            s[w] = ops::zero();
+
+        for (size_t i = 0; i < 2; ++i)
+            for (int b = 0; b < 64; ++b) {
+                if (polynomial[i] & UINT64_C(1) << b)
+                    for (size_t w = 0; w < 2; ++w)
+                        s[w] = ops::bit_xor(s[w], m_state[w]);
+                next();
+            }
+
+        for (size_t w = 0; w < 2; ++w)
+            m_state[w] = s[w];
     }
 
-    __m512i_u m_state[2];
+    vector_type m_state[2];
 };
 
-#endif // __AVX512F__
+using xoroshiro128plus_2 = xoroshiro128plus_n<2>;
 
-#endif
+#ifdef __AVX2__
+using xoroshiro128plus_4 = xoroshiro128plus_n<4>;
+#endif // __AVX2__
+
+#ifdef __AVX512F__
+using xoroshiro128plus_8 = xoroshiro128plus_n<8>;
+#endif // __AVX512F__
 
-#endif
+#endif // __AVX__ || SIMDRAND_NEON
 
 struct xoroshiro128plus {
+    using result_type = uint64_t;
+
+    //fill_u32() stores the high half of every output first, like the SIMD engines.
+    static constexpr bool high_half_first = true;
+
     xoroshiro128plus(uint64_t a, uint64_t b) noexcept
     {
         m_state[0] = a;
@@ -217,13 +311,97 @@ struct xoroshiro128plus {
         return result;
     }
 
+    //Smallest value next() can return.
+    static constexpr result_type min() noexcept { return 0; }
+
+    //Largest value next() can return.
+    static constexpr result_type max() noexcept { return UINT64_MAX; }
+
+    //Same as next(); makes the engine a UniformRandomBitGenerator usable with std::shuffle and the <random> distributions.
+    constexpr result_type operator()() noexcept { return next(); }
+
+    //Advances the state by 2^64 steps, equivalent to 2^64 calls of next().
+    //Can be used to generate 2^64 non-overlapping subsequences for parallel computations.
+    constexpr void jump() noexcept
+    {
+        jump(_jump);
+    }
+
+    //Advances the state by 2^96 steps, equivalent to 2^96 calls of next().
+    //Can be used to generate 2^32 starting points, from each of which jump() generates 2^32 non-overlapping subsequences.
+    constexpr void long_jump() noexcept
+    {
+        jump(_long_jump);
+    }
+
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        simdrand::fill(*this, dst, n);
+    }
+
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        simdrand::fill_bytes(*this, dst, n);
+    }
+
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
+    {
+        simdrand::fill_u32(*this, dst, n);
+    }
+
+    using state_type = uint64_t[2];
+
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(2, 1);
+
+    //Current state; an engine constructed from these words continues the sequence from here.
+    constexpr const state_type& state() const noexcept { return m_state; }
+
+    //Writes a snapshot of the state to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
+    {
+        simdrand::detail::save_state<2, 1>(dst, simdrand::engine_id::xoroshiro128plus, m_state);
+    }
+
+    //Restores a snapshot written by save_state() of the same engine.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
+    {
+        return simdrand::detail::load_state<2, 1>(src, simdrand::engine_id::xoroshiro128plus, m_state);
+    }
+
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept { return simdrand::hash_words(m_state, 2); }
+
     //Compares internal states of two engines for equality.
-    constexpr bool operator==(const xoroshiro128plus& other) const noexcept { return m_state[0] == other.m_state[0] && m_state[1] == other.m_state[1]; }
+    constexpr bool operator==(const xoroshiro128plus& other) const noexcept { return ((m_state[0] ^ other.m_state[0]) | (m_state[1] ^ other.m_state[1])) == 0; }
 
     //Compares internal states of two engines for inequality.
-    constexpr bool operator!=(const xoroshiro128plus& other) const noexcept { return m_state[0] != other.m_state[0] || m_state[1] != other.m_state[1]; }
+    constexpr bool operator!=(const xoroshiro128plus& other) const noexcept { return !(*this == other); }
 
 private:
+    template <size_t Width>
+    friend struct xoroshiro128plus_n;
+
+    //Advances the state by the number of steps encoded in polynomial.
+    constexpr void jump(const uint64_t (&polynomial)[2]) noexcept
+    {
+        uint64_t s[2] = {};
+        for (size_t i = 0; i < 2; ++i)
+            for (int b = 0; b < 64; ++b) {
+                if (polynomial[i] & UINT64_C(1) << b)
+                    for (size_t w = 0; w < 2; ++w)
+                        s[w] ^= m_state[w];
+                next();
+            }
+
+        for (size_t w = 0; w < 2; ++w)
+            m_state[w] = s[w];
+    }
+
     uint64_t m_state[2];
 
     constexpr static inline uint64_t rotl(const uint64_t x, int k) noexcept
@@ -231,6 +409,47 @@ private:
         return (x << k) | (x >> (64 - k));
     }
 };
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+
+template <size_t Width>
+inline xoroshiro128plus_n<Width>::xoroshiro128plus_n(xoroshiro128plus base) noexcept
+{
+    uint64_t lanes[2][Width];
+    for (size_t lane = 0; lane < Width; ++lane) {
+        if (lane != 0)
+            base.jump();
+        for (size_t i = 0; i < 2; ++i)
+            lanes[i][lane] = base.m_state[i];
+    }
+
+    for (size_t i = 0; i < 2; ++i)
+        m_state[i] = ops::load(lanes[i]);
+}
+
+#endif // __AVX__ || SIMDRAND_NEON
+
+//xoroshiro128+ step written once for uint64_t and vector extension types; instantiated for every width by dispatch.
+struct kernel {
+    static constexpr size_t words = 2;
+    static constexpr bool high_half_first = true;
+
+    template <typename V>
+    static inline void next(V (&s)[2], V& result) noexcept
+    {
+        const V s0 = s[0];
+        V s1 = s[1];
+        result = s0 + s1;
+
+        s1 ^= s0;
+        s[0] = ((s0 << 24) | (s0 >> 40)) ^ s1 ^ (s1 << 16);
+        s[1] = (s1 << 37) | (s1 >> 27);
+    }
+};
+
+//xoroshiro128+ engine using the widest kernel supported by the CPU it runs on.
+using dispatch = simdrand::dispatch<kernel>;
+
 }
 
 #endif // XOROSHIRO128PLUS_H_INCLUDED
@@ -4,165 +4,219 @@
 //Reference implementation: http://vigna.di.unimi.it/ftp/papers/xorshiftplus.pdf
 
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 
+#include "bulk.h"
+#include "dispatch.h"
+#include "simd.h"
 #include "splitmix.h"
+#include "state.h"
+#include "uniform.h"
 
 namespace xorshift128plus {
 
-#ifdef __AVX__
+//Jump polynomials of the underlying linear engine: applying them advances the state by 2^64 and 2^96 steps.
+constexpr uint64_t _jump[2] = { 0x8c405782bca686ad, 0xc44f35946fef49c6 };
+constexpr uint64_t _long_jump[2] = { 0xeec5431970b882bc, 0x397adbe826b37b9e };
 
-//xorshift128plus implementation using AVX to generate random __m128i_u.
-struct xorshift128plus_2 {
-    xorshift128plus_2(__m128i_u a, __m128i_u b) noexcept
+struct xorshift128plus;
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+
+//xorshift128plus implementation generating Width lanes per call: __m128i_u (uint64x2_t on AArch64), __m256i_u or __m512i_u.
+template <size_t Width>
+struct xorshift128plus_n {
+    using ops = simdrand::simd<Width>;
+    using vector_type = typename ops::type;
+
+    //The low bits of xorshift128+ fail linearity tests (the lowest one is an LFSR), so the 32-bit outputs take the high
+    //half of every lane first.
+    static constexpr bool high_half_first = true;
+
+    xorshift128plus_n(vector_type a, vector_type b) noexcept
     {
         m_state[0] = a;
         m_state[1] = b;
     }
 
-    xorshift128plus_2(uint64_t a, uint64_t b, uint64_t c, uint64_t d) noexcept
+    template <size_t W = Width, typename = typename std::enable_if<W == 2>::type>
+    xorshift128plus_n(uint64_t a, uint64_t b, uint64_t c, uint64_t d) noexcept
     {
-        m_state[0] = _mm_set_epi64x(a, b);
-        m_state[1] = _mm_set_epi64x(c, d);
+        m_state[0] = ops::set(a, b);
+        m_state[1] = ops::set(c, d);
     }
 
-    explicit xorshift128plus_2(splitmix::splitmix64 gen) noexcept
+    explicit xorshift128plus_n(splitmix::splitmix64 gen) noexcept
     {
-        m_state[0] = _mm_set_epi64x(gen.next(), gen.next());
-        m_state[1] = _mm_set_epi64x(gen.next(), gen.next());
+        m_state[0] = simdrand::draw<Width>(gen);
+        m_state[1] = simdrand::draw<Width>(gen);
     }
 
-    //Generates random __m128i_u.
-    __m128i_u next() noexcept
+    //Seeds lane i with the state of base advanced by i jumps, so the lanes do not overlap for 2^64 outputs.
+    explicit xorshift128plus_n(xorshift128plus base) noexcept;
+
+    //Generates Width random uint64_t, one per lane.
+    vector_type next() noexcept
     {
-        __m128i_u s1 = m_state[0];
-        __m128i_u s0 = m_state[1];
+        vector_type s1 = m_state[0];
+        vector_type s0 = m_state[1];
         m_state[0] = s0;
-        s1 = _mm_xor_si128(_mm_slli_epi64(s1, 23), s1);
-        m_state[1] = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi64(s1, 26), s0), _mm_xor_si128(_mm_srli_epi64(s0, 17), s1));
-        return _mm_add_epi64(m_state[0], m_state[1]);
+        s1 = ops::bit_xor(ops::template shl<23>(s1), s1);
+        m_state[1] = ops::bit_xor(ops::xor3(ops::template shr<17>(s1), s0, ops::template shr<26>(s0)), s1);
+        return ops::add(m_state[0], m_state[1]);
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const xorshift128plus_2& other) const noexcept
+    //Advances every lane by 2^64 steps, equivalent to 2^64 calls of next().
+    //Can be used to generate 2^64 non-overlapping subsequences for parallel computations.
+    void jump() noexcept
     {
-        __m128i_u cmp0 = _mm_cmpeq_epi32(other.m_state[0], m_state[0]);
-        __m128i_u cmp1 = _mm_cmpeq_epi32(other.m_state[1], m_state[1]);
-        uint16_t mask0 = _mm_movemask_epi8(cmp0);
-        uint16_t mask1 = _mm_movemask_epi8(cmp1);
-        return (mask0 == 0xffffU && mask1 == 0xffffU);
+        jump(_jump);
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const xorshift128plus_2& other) const noexcept
+    //Advances every lane by 2^96 steps, equivalent to 2^96 calls of next().
+    //Can be used to generate 2^32 starting points, from each of which jump() generates 2^32 non-overlapping subsequences.
+    void long_jump() noexcept
     {
-        return !(*this == other);
+        jump(_long_jump);
     }
 
-private:
-    __m128i_u m_state[2];
-};
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        simdrand::fill(*this, dst, n);
+    }
 
-#ifdef __AVX2__
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        simdrand::fill_bytes(*this, dst, n);
+    }
 
-//xorshift128plus implementation using AVX-2 to generate random __m256i_u.
-struct xorshift128plus_4 {
-    xorshift128plus_4(__m256i_u a, __m256i_u b) noexcept
+    //Generates 2 * Width random uint32_t, the 32-bit halves of every lane of next() in the order fill_u32() stores them.
+    vector_type next_u32() noexcept
     {
-        m_state[0] = a;
-        m_state[1] = b;
+        return simdrand::next_u32(*this);
     }
 
-    explicit xorshift128plus_4(splitmix::splitmix64 gen) noexcept
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
     {
-        m_state[0] = _mm256_set_epi64x(gen.next(), gen.next(), gen.next(), gen.next());
-        m_state[1] = _mm256_set_epi64x(gen.next(), gen.next(), gen.next(), gen.next());
+        simdrand::fill_u32(*this, dst, n);
     }
 
-    //Generates random __m256i_u.
-    __m256i_u next() noexcept
+    //Generates Width doubles uniformly distributed in [0, 1), (x >> 11) * 2^-53 for every lane x of next().
+    typename ops::double_type next_double() noexcept
     {
-        __m256i_u s1 = m_state[0];
-        __m256i_u s0 = m_state[1];
-        m_state[0] = s0;
-        s1 = _mm256_xor_si256(_mm256_slli_epi64(s1, 23), s1);
-        m_state[1] = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(s1, 26), s0), _mm256_xor_si256(_mm256_srli_epi64(s0, 17), s1));
-        return _mm256_add_epi32(m_state[0], m_state[1]);
+        return simdrand::to_double(next());
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const xorshift128plus_4& other) const noexcept
+    //Generates 2 * Width floats uniformly distributed in [0, 1), taken from both 32-bit halves of every lane of next().
+    typename ops::float_type next_float() noexcept
     {
-        __m256i_u cmp0 = _mm256_cmpeq_epi32(other.m_state[0], m_state[0]);
-        __m256i_u cmp1 = _mm256_cmpeq_epi32(other.m_state[1], m_state[1]);
-        uint32_t mask0 = _mm256_movemask_epi8(cmp0);
-        uint32_t mask1 = _mm256_movemask_epi8(cmp1);
-        return (mask0 == 0xffffffffU && mask1 == 0xffffffffU);
+        return simdrand::to_float(next());
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const xorshift128plus_4& other) const noexcept
+    //Fills dst with n doubles in [0, 1), as if consecutive next_double() results were stored one after another.
+    void fill_uniform(double* dst, size_t n) noexcept
     {
-        return !(*this == other);
+        simdrand::fill_uniform(*this, dst, n);
     }
 
-private:
-    __m256i_u m_state[2];
-};
+    //Fills dst with n floats in [0, 1), as if consecutive next_float() results were stored one after another.
+    void fill_uniform(float* dst, size_t n) noexcept
+    {
+        simdrand::fill_uniform(*this, dst, n);
+    }
 
-#ifdef __AVX512F__
+    using state_type = vector_type[2];
+
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(2, Width);
+
+    //Current state, one vector per state word; lane i holds the state of the i-th interleaved stream.
+    constexpr const state_type& state() const noexcept { return m_state; }
 
-//xorshift128plus implementation using AVX512F to generate random __m512i_u.
-struct xorshift128plus_8 {
-    xorshift128plus_8(__m512i_u a, __m512i_u b) noexcept
+    //Writes a snapshot of every lane to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
     {
-        m_state[0] = a;
-        m_state[1] = b;
+        uint64_t lanes[2 * Width];
+        std::memcpy(lanes, &m_state, sizeof(lanes));
+        simdrand::detail::save_state<2, Width>(dst, simdrand::engine_id::xorshift128plus, lanes);
     }
 
-    explicit xorshift128plus_8(splitmix::splitmix64 gen) noexcept
+    //Restores a snapshot written by save_state() of an engine of the same algorithm and width.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
     {
-        m_state[0] = _mm512_set_epi64(gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next());
-        m_state[1] = _mm512_set_epi64(gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next());
+        uint64_t lanes[2 * Width];
+        if (!simdrand::detail::load_state<2, Width>(src, simdrand::engine_id::xorshift128plus, lanes))
+            return false;
+
+        std::memcpy(&m_state, lanes, sizeof(lanes));
+        return true;
     }
 
-    //Generates random __m512i_u.
-    __m512i_u next() noexcept
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept
     {
-        __m512i_u s1 = m_state[0];
-        __m512i_u s0 = m_state[1];
-        m_state[0] = s0;
-        s1 = _mm512_xor_si512(_mm512_slli_epi64(s1, 23), s1);
-        m_state[1] = _mm512_xor_si512(_mm512_xor_si512(_mm512_srli_epi64(s1, 26), s0), _mm512_xor_si512(_mm512_srli_epi64(s0, 17), s1));
-        return _mm512_add_epi32(m_state[0], m_state[1]);
+        return simdrand::hash_state<Width>(m_state);
     }
 
     //Compares internal states of two engines for equality.
-    bool operator==(const xorshift128plus_8& other) const noexcept
+    bool operator==(const xorshift128plus_n& other) const noexcept
     {
-        __mmask8 cmp0 = _mm512_cmpeq_epi64_mask(other.m_state[0], m_state[0]);
-        __mmask8 cmp1 = _mm512_cmpeq_epi64_mask(other.m_state[1], m_state[1]);
-        //TODO: proper fast implementation.
-        uint16_t mask0 = _mm_movemask_epi8(_mm_movm_epi64(cmp0));
-        uint16_t mask1 = _mm_movemask_epi8(_mm_movm_epi64(cmp1));
-        return (mask0 == 0xffffU && mask1 == 0xffffU);
+        return simdrand::all_equal<Width>(m_state, other.m_state);
     }
 
     //Compares internal states of two engines for inequality.
-    bool operator!=(const xorshift128plus_8& other) const noexcept
+    bool operator!=(const xorshift128plus_n& other) const noexcept
     {
         return !(*this == other);
     }
 
 private:
-    __m512i_u m_state[2];
+    //Advances every lane by the number of steps encoded in polynomial.
+    void jump(const uint64_t (&polynomial)[2]) noexcept
+    {
+        vector_type s[2];
+        for (size_t w = 0; w < 2; ++w)
+            s[w] = ops::zero();
+
+        for (size_t i = 0; i < 2; ++i)
+            for (int b = 0; b < 64; ++b) {
+                if (polynomial[i] & UINT64_C(1) << b)
+                    for (size_t w = 0; w < 2; ++w)
+                        s[w] = ops::bit_xor(s[w], m_state[w]);
+                next();
+            }
+
+        for (size_t w = 0; w < 2; ++w)
+            m_state[w] = s[w];
+    }
+
+    vector_type m_state[2];
 };
 
-#endif // __AVX512F__
+using xorshift128plus_2 = xorshift128plus_n<2>;
+
+#ifdef __AVX2__
+using xorshift128plus_4 = xorshift128plus_n<4>;
 #endif // __AVX2__
-#endif // __AVX__
+
+#ifdef __AVX512F__
+using xorshift128plus_8 = xorshift128plus_n<8>;
+#endif // __AVX512F__
+
+#endif // __AVX__ || SIMDRAND_NEON
 
 //xorshift128plus implementation used to generate random uint64_t.
 struct xorshift128plus {
+    using result_type = uint64_t;
+
+    //Same 32-bit output order as xorshift128plus_n.
+    static constexpr bool high_half_first = true;
+
     xorshift128plus(uint64_t a, uint64_t b) noexcept
     {
         m_state[0] = a;
@@ -182,20 +236,143 @@ struct xorshift128plus {
         const uint64_t s0 = m_state[1];
         m_state[0] = s0;
         s1 ^= s1 << 23;
-        m_state[1] = s1 ^ s0 ^ (s1 >> 26) ^ (s0 >> 17);
+        m_state[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
         return m_state[1] + s0;
     }
 
+    //Smallest value next() can return.
+    static constexpr result_type min() noexcept { return 0; }
+
+    //Largest value next() can return.
+    static constexpr result_type max() noexcept { return UINT64_MAX; }
+
+    //Same as next(); makes the engine a UniformRandomBitGenerator usable with std::shuffle and the <random> distributions.
+    constexpr result_type operator()() noexcept { return next(); }
+
+    //Advances the state by 2^64 steps, equivalent to 2^64 calls of next().
+    //Can be used to generate 2^64 non-overlapping subsequences for parallel computations.
+    constexpr void jump() noexcept
+    {
+        jump(_jump);
+    }
+
+    //Advances the state by 2^96 steps, equivalent to 2^96 calls of next().
+    //Can be used to generate 2^32 starting points, from each of which jump() generates 2^32 non-overlapping subsequences.
+    constexpr void long_jump() noexcept
+    {
+        jump(_long_jump);
+    }
+
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        simdrand::fill(*this, dst, n);
+    }
+
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        simdrand::fill_bytes(*this, dst, n);
+    }
+
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
+    {
+        simdrand::fill_u32(*this, dst, n);
+    }
+
+    using state_type = uint64_t[2];
+
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(2, 1);
+
+    //Current state; an engine constructed from these words continues the sequence from here.
+    constexpr const state_type& state() const noexcept { return m_state; }
+
+    //Writes a snapshot of the state to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
+    {
+        simdrand::detail::save_state<2, 1>(dst, simdrand::engine_id::xorshift128plus, m_state);
+    }
+
+    //Restores a snapshot written by save_state() of the same engine.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
+    {
+        return simdrand::detail::load_state<2, 1>(src, simdrand::engine_id::xorshift128plus, m_state);
+    }
+
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept { return simdrand::hash_words(m_state, 2); }
+
     //Compares internal states of two engines for equality.
-    constexpr bool operator==(const xorshift128plus& other) const noexcept { return m_state[0] == other.m_state[0] && m_state[1] == other.m_state[1]; }
+    constexpr bool operator==(const xorshift128plus& other) const noexcept { return ((m_state[0] ^ other.m_state[0]) | (m_state[1] ^ other.m_state[1])) == 0; }
 
     //Compares internal states of two engines for inequality.
-    constexpr bool operator!=(const xorshift128plus& other) const noexcept { return m_state[0] != other.m_state[0] || m_state[1] != other.m_state[1]; }
+    constexpr bool operator!=(const xorshift128plus& other) const noexcept { return !(*this == other); }
 
 private:
+    template <size_t Width>
+    friend struct xorshift128plus_n;
+
+    //Advances the state by the number of steps encoded in polynomial.
+    constexpr void jump(const uint64_t (&polynomial)[2]) noexcept
+    {
+        uint64_t s[2] = {};
+        for (size_t i = 0; i < 2; ++i)
+            for (int b = 0; b < 64; ++b) {
+                if (polynomial[i] & UINT64_C(1) << b)
+                    for (size_t w = 0; w < 2; ++w)
+                        s[w] ^= m_state[w];
+                next();
+            }
+
+        for (size_t w = 0; w < 2; ++w)
+            m_state[w] = s[w];
+    }
+
     uint64_t m_state[2];
 };
 
+#if defined __AVX__ || defined SIMDRAND_NEON
+
+template <size_t Width>
+inline xorshift128plus_n<Width>::xorshift128plus_n(xorshift128plus base) noexcept
+{
+    uint64_t lanes[2][Width];
+    for (size_t lane = 0; lane < Width; ++lane) {
+        if (lane != 0)
+            base.jump();
+        for (size_t i = 0; i < 2; ++i)
+            lanes[i][lane] = base.m_state[i];
+    }
+
+    for (size_t i = 0; i < 2; ++i)
+        m_state[i] = ops::load(lanes[i]);
+}
+
+#endif // __AVX__ || SIMDRAND_NEON
+
+//xorshift128plus step written once for uint64_t and vector extension types; instantiated for every width by dispatch.
+struct kernel {
+    static constexpr size_t words = 2;
+    static constexpr bool high_half_first = true;
+
+    template <typename V>
+    static inline void next(V (&s)[2], V& result) noexcept
+    {
+        V s1 = s[0];
+        const V s0 = s[1];
+        s[0] = s0;
+        s1 ^= s1 << 23;
+        s[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+        result = s[1] + s0;
+    }
+};
+
+//xorshift128plus engine using the widest kernel supported by the CPU it runs on.
+using dispatch = simdrand::dispatch<kernel>;
+
 }
 
 #endif // XORSHIFT128PLUS_H_INCLUDED
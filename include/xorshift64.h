@@ -1,165 +1,172 @@
 #ifndef XORSHIFT64_H_INCLUDED
 #define XORSHIFT64_H_INCLUDED
 
-//Reference implementation: https://en.wikipedia.org/wiki/Xorshift
+//Reference implementation: https://en.wikipedia.org/wiki/Xorshift (Marsaglia's 64-bit triple 13, 7, 17)
 
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 
+#include "bulk.h"
+#include "dispatch.h"
+#include "simd.h"
 #include "splitmix.h"
+#include "state.h"
+#include "uniform.h"
 
 namespace xorshift64 {
 
-#ifdef __AVX__
+#if defined __AVX__ || defined SIMDRAND_NEON
 
-//xorshift64 implementation using AVX to generate random __m128i_u.
-struct xorshift64_2 {
-    explicit xorshift64_2(__m128i_u state) noexcept
+//xorshift64 implementation generating Width lanes per call: __m128i_u (uint64x2_t on AArch64), __m256i_u or __m512i_u.
+template <size_t Width>
+struct xorshift64_n {
+    using ops = simdrand::simd<Width>;
+    using vector_type = typename ops::type;
+
+    explicit xorshift64_n(vector_type state) noexcept
         : m_state(state)
     {
     }
 
-    xorshift64_2(uint64_t a, uint64_t b) noexcept
+    //Takes the state of every lane as uint64_t, highest lane first like _mm_set_epi64x().
+    template <typename... Lanes, typename = typename std::enable_if<sizeof...(Lanes) == Width>::type>
+    xorshift64_n(Lanes... lanes) noexcept
     {
-        m_state = _mm_set_epi64x(a, b);
+        m_state = ops::set(static_cast<uint64_t>(lanes)...);
     }
 
-    explicit xorshift64_2(splitmix::splitmix64 gen) noexcept
+    explicit xorshift64_n(splitmix::splitmix64 gen) noexcept
     {
-        m_state = _mm_set_epi64x(gen.next(), gen.next());
+        m_state = simdrand::draw<Width>(gen);
     }
 
-    constexpr operator __m128i_u() const noexcept { return m_state; }
+    constexpr operator vector_type() const noexcept { return m_state; }
 
-    //Generates random __m128i_u.
-    __m128i_u next() noexcept
+    //Generates Width random uint64_t, one per lane.
+    vector_type next() noexcept
     {
-        m_state = _mm_xor_si128(m_state, _mm_srli_epi64(m_state, 13));
-        m_state = _mm_xor_si128(m_state, _mm_slli_epi64(m_state, 17));
-        m_state = _mm_xor_si128(m_state, _mm_srli_epi64(m_state, 5));
+        m_state = ops::bit_xor(m_state, ops::template shl<13>(m_state));
+        m_state = ops::bit_xor(m_state, ops::template shr<7>(m_state));
+        m_state = ops::bit_xor(m_state, ops::template shl<17>(m_state));
         return m_state;
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const xorshift64_2& other) const noexcept
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
     {
-        __m128i_u cmp = _mm_cmpeq_epi32(other.m_state, m_state);
-        uint16_t mask = _mm_movemask_epi8(cmp);
-        return (mask == 0xffffU);
+        simdrand::fill(*this, dst, n);
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const xorshift64_2& other) const noexcept
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
     {
-        return !(*this == other);
+        simdrand::fill_bytes(*this, dst, n);
     }
 
-private:
-    __m128i_u m_state;
-};
-
-#ifdef __AVX2__
-
-//xorshift64 implementation using AVX-2 to generate random __m256i_u.
-struct xorshift64_4 {
-    explicit xorshift64_4(__m256i_u state) noexcept
-        : m_state(state)
+    //Generates 2 * Width random uint32_t, the 32-bit halves of every lane of next() in the order fill_u32() stores them.
+    vector_type next_u32() noexcept
     {
+        return simdrand::next_u32(*this);
     }
 
-    xorshift64_4(uint64_t a, uint64_t b, uint64_t c, uint64_t d) noexcept
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
     {
-        m_state = _mm256_set_epi64x(a, b, c, d);
+        simdrand::fill_u32(*this, dst, n);
     }
 
-    explicit xorshift64_4(splitmix::splitmix64 gen) noexcept
+    //Generates Width doubles uniformly distributed in [0, 1), (x >> 11) * 2^-53 for every lane x of next().
+    typename ops::double_type next_double() noexcept
     {
-        m_state = _mm256_set_epi64x(gen.next(), gen.next(), gen.next(), gen.next());
+        return simdrand::to_double(next());
     }
 
-    constexpr operator __m256i_u() const noexcept { return m_state; }
-
-    //Generates random __m128i_u.
-    __m256i_u next() noexcept
+    //Generates 2 * Width floats uniformly distributed in [0, 1), taken from both 32-bit halves of every lane of next().
+    typename ops::float_type next_float() noexcept
     {
-        m_state = _mm256_xor_si256(m_state, _mm256_srli_epi64(m_state, 13));
-        m_state = _mm256_xor_si256(m_state, _mm256_slli_epi64(m_state, 17));
-        m_state = _mm256_xor_si256(m_state, _mm256_srli_epi64(m_state, 5));
-        return m_state;
+        return simdrand::to_float(next());
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const xorshift64_4& other) const noexcept
+    //Fills dst with n doubles in [0, 1), as if consecutive next_double() results were stored one after another.
+    void fill_uniform(double* dst, size_t n) noexcept
     {
-        __m256i_u cmp0 = _mm256_cmpeq_epi32(other.m_state, m_state);
-        uint32_t mask0 = _mm256_movemask_epi8(cmp0);
-        return mask0 == 0xffffffffU;
+        simdrand::fill_uniform(*this, dst, n);
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const xorshift64_4& other) const noexcept
+    //Fills dst with n floats in [0, 1), as if consecutive next_float() results were stored one after another.
+    void fill_uniform(float* dst, size_t n) noexcept
     {
-        return !(*this == other);
+        simdrand::fill_uniform(*this, dst, n);
     }
 
-private:
-    __m256i_u m_state;
-};
+    using state_type = vector_type;
 
-#ifdef __AVX512F__
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(1, Width);
 
-//xorshift64 implementation using AVX512F to generate random __m512i_u.
-struct xorshift64_8 {
-    explicit xorshift64_8(__m512i_u state) noexcept
-        : m_state(state)
-    {
-    }
+    //Current state; lane i holds the state of the i-th interleaved stream.
+    constexpr const state_type& state() const noexcept { return m_state; }
 
-    xorshift64_8(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t g, uint64_t h) noexcept
+    //Writes a snapshot of every lane to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
     {
-        m_state = _mm512_set_epi64(a, b, c, d, e, f, g, h);
+        uint64_t lanes[Width];
+        std::memcpy(lanes, &m_state, sizeof(lanes));
+        simdrand::detail::save_state<1, Width>(dst, simdrand::engine_id::xorshift64, lanes);
     }
 
-    explicit xorshift64_8(splitmix::splitmix64 gen) noexcept
+    //Restores a snapshot written by save_state() of an engine of the same algorithm and width.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
     {
-        m_state = _mm512_set_epi64(gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next());
-    }
+        uint64_t lanes[Width];
+        if (!simdrand::detail::load_state<1, Width>(src, simdrand::engine_id::xorshift64, lanes))
+            return false;
 
-    constexpr operator __m512i_u() const noexcept { return m_state; }
+        std::memcpy(&m_state, lanes, sizeof(lanes));
+        return true;
+    }
 
-    //Generates random __m512i_u.
-    __m512i_u next() noexcept
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept
     {
-        m_state = _mm512_xor_si512(m_state, _mm512_srli_epi64(m_state, 13));
-        m_state = _mm512_xor_si512(m_state, _mm512_slli_epi64(m_state, 17));
-        m_state = _mm512_xor_si512(m_state, _mm512_srli_epi64(m_state, 5));
-        return m_state;
+        const vector_type words[1] = { m_state };
+        return simdrand::hash_state<Width>(words);
     }
 
     //Compares internal states of two engines for equality.
-    bool operator==(const xorshift64_8& other) const noexcept
+    bool operator==(const xorshift64_n& other) const noexcept
     {
-        __mmask8 cmp0 = _mm512_cmpeq_epi64_mask(other.m_state, m_state);
-        //TODO: proper fast implementation.
-        uint16_t mask0 = _mm_movemask_epi8(_mm_movm_epi64(cmp0));
-        return (mask0 == 0xffffU);
+        return ops::equal(other.m_state, m_state);
     }
 
     //Compares internal states of two engines for inequality.
-    bool operator!=(const xorshift64_8& other) const noexcept
+    bool operator!=(const xorshift64_n& other) const noexcept
     {
         return !(*this == other);
     }
 
 private:
-    __m512i_u m_state;
+    vector_type m_state;
 };
 
-#endif // __AVX512F__
+using xorshift64_2 = xorshift64_n<2>;
+
+#ifdef __AVX2__
+using xorshift64_4 = xorshift64_n<4>;
 #endif // __AVX2__
-#endif // __AVX__
+
+#ifdef __AVX512F__
+using xorshift64_8 = xorshift64_n<8>;
+#endif // __AVX512F__
+
+#endif // __AVX__ || SIMDRAND_NEON
 
 //xorshift64 implementation used to generate random uint64_t.
 struct xorshift64 {
+    using result_type = uint64_t;
+
     explicit xorshift64(uint64_t state) noexcept
         : m_state(state)
     {
@@ -171,11 +178,62 @@ struct xorshift64 {
     constexpr uint64_t next() noexcept
     {
         m_state ^= m_state << 13;
-        m_state ^= m_state >> 17;
-        m_state ^= m_state << 5;
+        m_state ^= m_state >> 7;
+        m_state ^= m_state << 17;
         return m_state;
     }
 
+    //Smallest value next() can return; the state, which is also the output, never becomes 0.
+    static constexpr result_type min() noexcept { return 1; }
+
+    //Largest value next() can return.
+    static constexpr result_type max() noexcept { return UINT64_MAX; }
+
+    //Same as next(); makes the engine a UniformRandomBitGenerator usable with std::shuffle and the <random> distributions.
+    constexpr result_type operator()() noexcept { return next(); }
+
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        simdrand::fill(*this, dst, n);
+    }
+
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        simdrand::fill_bytes(*this, dst, n);
+    }
+
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
+    {
+        simdrand::fill_u32(*this, dst, n);
+    }
+
+    using state_type = uint64_t;
+
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(1, 1);
+
+    //Current state; an engine constructed from it continues the sequence from here.
+    constexpr const state_type& state() const noexcept { return m_state; }
+
+    //Writes a snapshot of the state to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
+    {
+        simdrand::detail::save_state<1, 1>(dst, simdrand::engine_id::xorshift64, &m_state);
+    }
+
+    //Restores a snapshot written by save_state() of the same engine.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
+    {
+        return simdrand::detail::load_state<1, 1>(src, simdrand::engine_id::xorshift64, &m_state);
+    }
+
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept { return simdrand::hash_words(&m_state, 1); }
+
     //Compares internal states of two engines for equality.
     constexpr bool operator==(const xorshift64& other) const noexcept { return other.m_state == m_state; }
 
@@ -186,6 +244,23 @@ private:
     uint64_t m_state;
 };
 
+//xorshift64 step written once for uint64_t and vector extension types; instantiated for every width by dispatch.
+struct kernel {
+    static constexpr size_t words = 1;
+
+    template <typename V>
+    static inline void next(V (&s)[1], V& result) noexcept
+    {
+        s[0] ^= s[0] << 13;
+        s[0] ^= s[0] >> 7;
+        s[0] ^= s[0] << 17;
+        result = s[0];
+    }
+};
+
+//xorshift64 engine using the widest kernel supported by the CPU it runs on.
+using dispatch = simdrand::dispatch<kernel>;
+
 }
 
 #endif // XORSHIFT64_H_INCLUDED
@@ -2,16 +2,34 @@
 #define XOSHIRO256SS_H_INCLUDED
 
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 
+#include "bounded.h"
+#include "bulk.h"
+#include "dispatch.h"
+#include "simd.h"
 #include "splitmix.h"
+#include "state.h"
+#include "uniform.h"
 
 namespace xoshiro256ss {
 
-#ifdef __AVX__
+//Jump polynomials of the underlying linear engine: applying them advances the state by 2^128 and 2^192 steps.
+constexpr uint64_t _jump[4] = { 0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c };
+constexpr uint64_t _long_jump[4] = { 0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241, 0x39109bb02acbe635 };
 
-//xoshiro256** implementation using AVX instruction set to generate random __m128i_u.
-struct xoshiro256ss_2 {
-    xoshiro256ss_2(__m128i_u a, __m128i_u b, __m128i_u c, __m128i_u d) noexcept
+struct xoshiro256ss;
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+
+//xoshiro256** implementation generating Width lanes per call: __m128i_u (uint64x2_t on AArch64), __m256i_u or __m512i_u.
+template <size_t Width>
+struct xoshiro256ss_n {
+    using ops = simdrand::simd<Width>;
+    using vector_type = typename ops::type;
+
+    xoshiro256ss_n(vector_type a, vector_type b, vector_type c, vector_type d) noexcept
     {
         m_state[0] = a;
         m_state[1] = b;
@@ -19,222 +37,224 @@ struct xoshiro256ss_2 {
         m_state[3] = d;
     }
 
-    xoshiro256ss_2(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t g, uint64_t h) noexcept
+    template <size_t W = Width, typename = typename std::enable_if<W == 2>::type>
+    xoshiro256ss_n(uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t e, uint64_t f, uint64_t g, uint64_t h) noexcept
     {
-        m_state[0] = _mm_set_epi64x(a, b);
-        m_state[1] = _mm_set_epi64x(c, d);
-        m_state[2] = _mm_set_epi64x(e, f);
-        m_state[3] = _mm_set_epi64x(g, h);
+        m_state[0] = ops::set(a, b);
+        m_state[1] = ops::set(c, d);
+        m_state[2] = ops::set(e, f);
+        m_state[3] = ops::set(g, h);
     }
 
-    explicit xoshiro256ss_2(splitmix::splitmix64 gen) noexcept
+    explicit xoshiro256ss_n(splitmix::splitmix64 gen) noexcept
     {
         for (size_t i = 0; i < 4; ++i)
-            m_state[i] = _mm_set_epi64x(gen.next(), gen.next());
+            m_state[i] = simdrand::draw<Width>(gen);
     }
 
-    //Generates random __m128i_u.
-    __m128i_u next() noexcept
+    //Seeds lane i with the state of base advanced by i jumps, so the lanes do not overlap for 2^128 outputs.
+    explicit xoshiro256ss_n(xoshiro256ss base) noexcept;
+
+    //Generates Width random uint64_t, one per lane.
+    vector_type next() noexcept
     {
         //m_state[1] * 5 is calculated as m_state[1] + (m_state[1] << 2)
-        const __m128i_u rotl_result = rotl(_mm_add_epi64(m_state[1], _mm_slli_epi64(m_state[1], 2)), 7);
+        const vector_type rotl_result = ops::template rotl<7>(ops::add(m_state[1], ops::template shl<2>(m_state[1])));
 
         //rotl_result * 9 is calculated as rotl_result + (rotl_result << 3)
-        const __m128i_u result = _mm_add_epi64(rotl_result, _mm_slli_epi64(rotl_result, 3));
+        const vector_type result = ops::add(rotl_result, ops::template shl<3>(rotl_result));
 
-        const __m128i_u t = _mm_slli_epi64(m_state[1], 17);
+        const vector_type t = ops::template shl<17>(m_state[1]);
 
-        m_state[2] = _mm_xor_si128(m_state[0], m_state[2]);
-        m_state[3] = _mm_xor_si128(m_state[1], m_state[3]);
-        m_state[1] = _mm_xor_si128(m_state[2], m_state[1]);
-        m_state[0] = _mm_xor_si128(m_state[3], m_state[0]);
+        m_state[2] = ops::bit_xor(m_state[0], m_state[2]);
+        m_state[3] = ops::bit_xor(m_state[1], m_state[3]);
+        m_state[1] = ops::bit_xor(m_state[2], m_state[1]);
+        m_state[0] = ops::bit_xor(m_state[3], m_state[0]);
 
-        m_state[2] = _mm_xor_si128(t, m_state[2]);
+        m_state[2] = ops::bit_xor(t, m_state[2]);
 
-        m_state[3] = rotl(m_state[3], 45);
+        m_state[3] = ops::template rotl<45>(m_state[3]);
 
         return result;
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const xoshiro256ss_2& other) const noexcept
+    //Advances every lane by 2^128 steps, equivalent to 2^128 calls of next().
+    //Can be used to generate 2^128 non-overlapping subsequences for parallel computations.
+    void jump() noexcept
     {
-        //TODO: Check whether its faster than creating all 4 masks simultaniously and then comparing all of them with 0xffffU in return statement.
-        for (size_t i = 0; i < 4; ++i) {
-            __m128i_u cmp = _mm_cmpeq_epi32(other.m_state[i], m_state[i]);
-            uint16_t mask = _mm_movemask_epi8(cmp);
-            if (mask != 0xffffU)
-                return false;
-        }
-
-        return true;
+        jump(_jump);
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const xoshiro256ss_2& other) const noexcept
+    //Advances every lane by 2^192 steps, equivalent to 2^192 calls of next().
+    //Can be used to generate 2^64 starting points, from each of which jump() generates 2^64 non-overlapping subsequences.
+    void long_jump() noexcept
     {
-        return !(*this == other);
+        jump(_long_jump);
     }
 
-private:
-    static inline __m128i_u rotl(const __m128i_u x, int k) noexcept
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
     {
-        __m128i_u a = _mm_slli_epi64(x, k);
-        __m128i_u b = _mm_srli_epi64(x, 64 - k);
-        return _mm_or_si128(a, b);
+        simdrand::fill(*this, dst, n);
     }
 
-    __m128i_u m_state[4];
-};
-
-#ifdef __AVX2__
-
-struct xoshiro256ss_4 {
-    xoshiro256ss_4(__m256i_u a, __m256i_u b, __m256i_u c, __m256i_u d) noexcept
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
     {
-        m_state[0] = a;
-        m_state[1] = b;
-        m_state[0] = c;
-        m_state[1] = d;
+        simdrand::fill_bytes(*this, dst, n);
     }
 
-    explicit xoshiro256ss_4(splitmix::splitmix64 gen) noexcept
+    //Generates 2 * Width random uint32_t, the 32-bit halves of every lane of next() in the order fill_u32() stores them.
+    vector_type next_u32() noexcept
     {
-        for (int i = 0; i < 4; ++i)
-            m_state[i] = _mm256_set_epi64x(gen.next(), gen.next(), gen.next(), gen.next());
+        return simdrand::next_u32(*this);
     }
 
-    //Generates random __m256i_u.
-    __m256i_u next() noexcept
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
     {
-        //m_state[1] * 5 is calculated as m_state[1] + (m_state[1] << 2)
-        const __m256i_u rotl_result = rotl(_mm256_add_epi64(m_state[1], _mm256_slli_epi64(m_state[1], 2)), 7);
-
-        //rotl_result * 9 is calculated as rotl_result + (rotl_result << 3)
-        const __m256i_u result = _mm256_add_epi64(rotl_result, _mm256_slli_epi64(rotl_result, 3));
-
-        const __m256i_u t = _mm256_slli_epi64(m_state[1], 17);
-
-        m_state[2] = _mm256_xor_si256(m_state[0], m_state[2]);
-        m_state[3] = _mm256_xor_si256(m_state[1], m_state[3]);
-        m_state[1] = _mm256_xor_si256(m_state[2], m_state[1]);
-        m_state[0] = _mm256_xor_si256(m_state[3], m_state[0]);
-
-        m_state[2] = _mm256_xor_si256(t, m_state[2]);
-
-        m_state[3] = rotl(m_state[3], 45);
-
-        return result;
+        simdrand::fill_u32(*this, dst, n);
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const xoshiro256ss_4& other) const noexcept
+    //Generates Width doubles uniformly distributed in [0, 1), (x >> 11) * 2^-53 for every lane x of next().
+    typename ops::double_type next_double() noexcept
     {
-        for (size_t i = 0; i < 4; ++i) {
-            __m256i_u cmp = _mm256_cmpeq_epi32(other.m_state[i], m_state[i]);
-            uint16_t mask = _mm256_movemask_epi8(cmp);
-            if (mask != 0xffffffffU)
-                return false;
-        }
-
-        return true;
+        return simdrand::to_double(next());
     }
 
-    //Compares internal states of two engines for inequality.
-    bool operator!=(const xoshiro256ss_4& other) const noexcept
+    //Generates 2 * Width floats uniformly distributed in [0, 1), taken from both 32-bit halves of every lane of next().
+    typename ops::float_type next_float() noexcept
     {
-        return !(*this == other);
+        return simdrand::to_float(next());
     }
 
-private:
-    static inline __m256i_u rotl(const __m256i_u x, int k) noexcept
+    //Fills dst with n doubles in [0, 1), as if consecutive next_double() results were stored one after another.
+    void fill_uniform(double* dst, size_t n) noexcept
     {
-        __m256i_u a = _mm256_slli_epi64(x, k);
-        __m256i_u b = _mm256_srli_epi64(x, 64 - k);
-        return _mm256_or_si256(a, b);
+        simdrand::fill_uniform(*this, dst, n);
     }
 
-    __m256i_u m_state[4];
-};
-
-#ifdef __AVX512F__
+    //Fills dst with n floats in [0, 1), as if consecutive next_float() results were stored one after another.
+    void fill_uniform(float* dst, size_t n) noexcept
+    {
+        simdrand::fill_uniform(*this, dst, n);
+    }
 
-//xoshiro256** implementation using AVX512F instruction set to generate random __m512i_u.
-struct xoshiro256ss_8 {
-    xoshiro256ss_8(__m512i_u a, __m512i_u b, __m512i_u c, __m512i_u d) noexcept
+#ifdef __AVX2__
+    //The bounded integers only exist for 4 and 8 lanes.
+    //Generates 2 * Width independent 32-bit integers uniformly distributed in [0, range), range must not be 0.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    vector_type next_bounded(uint32_t range) noexcept
     {
-        m_state[0] = a;
-        m_state[1] = b;
-        m_state[2] = c;
-        m_state[3] = d;
+        return simdrand::next_bounded(*this, range);
     }
 
-    explicit xoshiro256ss_8(splitmix::splitmix64 gen) noexcept
+    //Generates Width independent 64-bit integers uniformly distributed in [0, range), range must not be 0.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    vector_type next_bounded64(uint64_t range) noexcept
     {
-        for (size_t i = 0; i < 4; ++i)
-            m_state[i] = _mm512_set_epi64(gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next(), gen.next());
+        return simdrand::next_bounded64(*this, range);
     }
 
-    //Generates random __m512i_u.
-    __m512i_u next() noexcept
+    //Fills dst with n 32-bit integers uniformly distributed in [0, range), range must not be 0.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    void fill_bounded(uint32_t* dst, size_t n, uint32_t range) noexcept
     {
-        //_mm512_mullo_epi64() is slower than using shift + add; it also requires AVX512DQ instruction set.
-        //m_state[1] * 5 is calculated as m_state[1] + (m_state[1] << 2)
-        const __m512i_u rotl_result = rotl(_mm512_add_epi64(m_state[1], _mm512_slli_epi64(m_state[1], 2)), 7);
-        //rotl_result * 9 is calculated as rotl_result + (rotl_result << 3)
-        const __m512i_u result = _mm512_add_epi64(rotl_result, _mm512_slli_epi64(rotl_result, 3));
+        simdrand::fill_bounded(*this, dst, n, range);
+    }
 
-        const __m512i_u t = _mm512_slli_epi64(m_state[1], 17);
+    //Fills dst with n 64-bit integers uniformly distributed in [0, range), range must not be 0.
+    template <size_t W = Width, typename = typename std::enable_if<W >= 4>::type>
+    void fill_bounded(uint64_t* dst, size_t n, uint64_t range) noexcept
+    {
+        simdrand::fill_bounded(*this, dst, n, range);
+    }
+#endif // __AVX2__
 
-        m_state[2] = _mm512_xor_si512(m_state[0], m_state[2]);
-        m_state[3] = _mm512_xor_si512(m_state[1], m_state[3]);
-        m_state[1] = _mm512_xor_si512(m_state[2], m_state[1]);
-        m_state[0] = _mm512_xor_si512(m_state[3], m_state[0]);
+    using state_type = vector_type[4];
 
-        m_state[2] = _mm512_xor_si512(t, m_state[2]);
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(4, Width);
 
-        m_state[3] = rotl(m_state[3], 45);
+    //Current state, one vector per state word; lane i holds the state of the i-th interleaved stream.
+    constexpr const state_type& state() const noexcept { return m_state; }
 
-        return result;
+    //Writes a snapshot of every lane to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
+    {
+        uint64_t lanes[4 * Width];
+        std::memcpy(lanes, &m_state, sizeof(lanes));
+        simdrand::detail::save_state<4, Width>(dst, simdrand::engine_id::xoshiro256ss, lanes);
     }
 
-    //Compares internal states of two engines for equality.
-    bool operator==(const xoshiro256ss_8& other) const noexcept
+    //Restores a snapshot written by save_state() of an engine of the same algorithm and width.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
     {
-        for (size_t i = 0; i < 4; ++i) {
-            __mmask8 cmp = _mm512_cmpeq_epi64_mask(other.m_state[i], m_state[i]);
-            uint16_t mask = _mm_movemask_epi8(_mm_movm_epi64(cmp));
-            if (mask != 0xffffU)
-                return false;
-        }
+        uint64_t lanes[4 * Width];
+        if (!simdrand::detail::load_state<4, Width>(src, simdrand::engine_id::xoshiro256ss, lanes))
+            return false;
 
+        std::memcpy(&m_state, lanes, sizeof(lanes));
         return true;
     }
 
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept
+    {
+        return simdrand::hash_state<Width>(m_state);
+    }
+
+    //Compares internal states of two engines for equality.
+    bool operator==(const xoshiro256ss_n& other) const noexcept
+    {
+        return simdrand::all_equal<Width>(m_state, other.m_state);
+    }
+
     //Compares internal states of two engines for inequality.
-    bool operator!=(const xoshiro256ss_8& other) const noexcept
+    bool operator!=(const xoshiro256ss_n& other) const noexcept
     {
         return !(*this == other);
     }
 
 private:
-    static inline __m512i_u rotl(const __m512i_u x, int k) noexcept
+    //Advances every lane by the number of steps encoded in polynomial.
+    void jump(const uint64_t (&polynomial)[4]) noexcept
     {
-        __m512i_u a = _mm512_slli_epi64(x, k);
-        __m512i_u b = _mm512_srli_epi64(x, 64 - k);
-        return _mm512_or_si512(a, b);
+        vector_type s[4];
+        for (size_t w = 0; w < 4; ++w)
+            s[w] = ops::zero();
+
+        for (size_t i = 0; i < 4; ++i)
+            for (int b = 0; b < 64; ++b) {
+                if (polynomial[i] & UINT64_C(1) << b)
+                    for (size_t w = 0; w < 4; ++w)
+                        s[w] = ops::bit_xor(s[w], m_state[w]);
+                next();
+            }
+
+        for (size_t w = 0; w < 4; ++w)
+            m_state[w] = s[w];
     }
 
-    __m512i_u m_state[4];
+    vector_type m_state[4];
 };
 
-#endif // __AVX512F__
+using xoshiro256ss_2 = xoshiro256ss_n<2>;
+
+#ifdef __AVX2__
+using xoshiro256ss_4 = xoshiro256ss_n<4>;
+#endif // __AVX2__
 
-#endif
+#ifdef __AVX512F__
+using xoshiro256ss_8 = xoshiro256ss_n<8>;
+#endif // __AVX512F__
 
-#endif
+#endif // __AVX__ || SIMDRAND_NEON
 
 struct xoshiro256ss {
+    using result_type = uint64_t;
+
     xoshiro256ss(uint64_t a, uint64_t b, uint64_t c, uint64_t d) noexcept
     {
         m_state[0] = a;
@@ -268,13 +288,97 @@ struct xoshiro256ss {
         return result;
     }
 
+    //Smallest value next() can return.
+    static constexpr result_type min() noexcept { return 0; }
+
+    //Largest value next() can return.
+    static constexpr result_type max() noexcept { return UINT64_MAX; }
+
+    //Same as next(); makes the engine a UniformRandomBitGenerator usable with std::shuffle and the <random> distributions.
+    constexpr result_type operator()() noexcept { return next(); }
+
+    //Advances the state by 2^128 steps, equivalent to 2^128 calls of next().
+    //Can be used to generate 2^128 non-overlapping subsequences for parallel computations.
+    constexpr void jump() noexcept
+    {
+        jump(_jump);
+    }
+
+    //Advances the state by 2^192 steps, equivalent to 2^192 calls of next().
+    //Can be used to generate 2^64 starting points, from each of which jump() generates 2^64 non-overlapping subsequences.
+    constexpr void long_jump() noexcept
+    {
+        jump(_long_jump);
+    }
+
+    //Fills dst with n random uint64_t, as if consecutive next() results were stored one after another.
+    void fill(uint64_t* dst, size_t n) noexcept
+    {
+        simdrand::fill(*this, dst, n);
+    }
+
+    //Fills n bytes at dst with random data; the engine advances by whole outputs.
+    void fill_bytes(void* dst, size_t n) noexcept
+    {
+        simdrand::fill_bytes(*this, dst, n);
+    }
+
+    //Fills dst with n random uint32_t, two from every 64-bit output.
+    void fill_u32(uint32_t* dst, size_t n) noexcept
+    {
+        simdrand::fill_u32(*this, dst, n);
+    }
+
+    using state_type = uint64_t[4];
+
+    //Size in bytes of the snapshot save_state() writes.
+    static constexpr size_t state_size = simdrand::state_size(4, 1);
+
+    //Current state; an engine constructed from these words continues the sequence from here.
+    constexpr const state_type& state() const noexcept { return m_state; }
+
+    //Writes a snapshot of the state to dst, state_size bytes in the portable format described in state.h.
+    void save_state(unsigned char* dst) const noexcept
+    {
+        simdrand::detail::save_state<4, 1>(dst, simdrand::engine_id::xoshiro256ss, m_state);
+    }
+
+    //Restores a snapshot written by save_state() of the same engine.
+    //Returns false and leaves the engine unchanged if src holds any other snapshot.
+    bool load_state(const unsigned char* src) noexcept
+    {
+        return simdrand::detail::load_state<4, 1>(src, simdrand::engine_id::xoshiro256ss, m_state);
+    }
+
+    //Hash of the state for hash tables, equal for engines that compare equal.
+    uint64_t state_hash() const noexcept { return simdrand::hash_words(m_state, 4); }
+
     //Compares internal states of two engines for equality.
-    constexpr bool operator==(const xoshiro256ss& other) const noexcept { return m_state[0] == other.m_state[0] && m_state[1] == other.m_state[1] && m_state[2] == other.m_state[2] && m_state[3] == other.m_state[3]; }
+    constexpr bool operator==(const xoshiro256ss& other) const noexcept { return ((m_state[0] ^ other.m_state[0]) | (m_state[1] ^ other.m_state[1]) | (m_state[2] ^ other.m_state[2]) | (m_state[3] ^ other.m_state[3])) == 0; }
 
     //Compares internal states of two engines for inequality.
-    constexpr bool operator!=(const xoshiro256ss& other) const noexcept { return m_state[0] != other.m_state[0] || m_state[1] != other.m_state[1] || m_state[2] != other.m_state[2] || m_state[3] != other.m_state[3]; }
+    constexpr bool operator!=(const xoshiro256ss& other) const noexcept { return !(*this == other); }
 
 private:
+    template <size_t Width>
+    friend struct xoshiro256ss_n;
+
+    //Advances the state by the number of steps encoded in polynomial.
+    constexpr void jump(const uint64_t (&polynomial)[4]) noexcept
+    {
+        uint64_t s[4] = {};
+        for (size_t i = 0; i < 4; ++i)
+            for (int b = 0; b < 64; ++b) {
+                if (polynomial[i] & UINT64_C(1) << b)
+                    for (size_t w = 0; w < 4; ++w)
+                        s[w] ^= m_state[w];
+                next();
+            }
+
+        for (size_t w = 0; w < 4; ++w)
+            m_state[w] = s[w];
+    }
+
     uint64_t m_state[4];
 
     constexpr static inline uint64_t rotl(const uint64_t x, int k) noexcept
@@ -282,6 +386,54 @@ private:
         return (x << k) | (x >> (64 - k));
     }
 };
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+
+template <size_t Width>
+inline xoshiro256ss_n<Width>::xoshiro256ss_n(xoshiro256ss base) noexcept
+{
+    uint64_t lanes[4][Width];
+    for (size_t lane = 0; lane < Width; ++lane) {
+        if (lane != 0)
+            base.jump();
+        for (size_t i = 0; i < 4; ++i)
+            lanes[i][lane] = base.m_state[i];
+    }
+
+    for (size_t i = 0; i < 4; ++i)
+        m_state[i] = ops::load(lanes[i]);
+}
+
+#endif // __AVX__ || SIMDRAND_NEON
+
+//xoshiro256** step written once for uint64_t and vector extension types; instantiated for every width by dispatch.
+struct kernel {
+    static constexpr size_t words = 4;
+
+    template <typename V>
+    static inline void next(V (&s)[4], V& result) noexcept
+    {
+        //s[1] * 5 and rotated * 9 are calculated with shifts, as 64-bit vector multiplication needs AVX512DQ.
+        const V times5 = s[1] + (s[1] << 2);
+        const V rotated = (times5 << 7) | (times5 >> 57);
+        result = rotated + (rotated << 3);
+
+        const V t = s[1] << 17;
+
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+
+        s[2] ^= t;
+
+        s[3] = (s[3] << 45) | (s[3] >> 19);
+    }
+};
+
+//xoshiro256** engine using the widest kernel supported by the CPU it runs on.
+using dispatch = simdrand::dispatch<kernel>;
+
 }
 
 #endif // XOSHIRO256SS_H_INCLUDED
@@ -0,0 +1,1103 @@
+//Correctness tests of the engines at every width the compiler flags enable:
+//- known-answer vectors of every scalar engine, from the reference implementations of each algorithm (the state {1, 2}
+//  or {1, 2, 3, 4} for the xor-based engines, then after jump() and long_jump()) and the Random123 philox4x32-10 vectors;
+//- lane i of every _2, _4 and _8 engine against the scalar engine with the state of that lane, for next(), fill(),
+//  jump() and long_jump();
+//- every dispatch kernel against the scalar engines and against each other, including the non-temporal path;
+//- fill_uniform() bit for bit against the scalar conversions;
+//- fill_bounded() and next_bounded() of the _4 and _8 engines against scalar Lemire sampling of their streams;
+//- the mean and variance of the normal doubles at a fixed seed, and the normal floats against the doubles;
+//- buffered<Engine> against the fill() stream of the wrapped engine;
+//- parallel_fill() with several thread counts against the chunk engines filled one chunk after another;
+//- splitmix::at() and splitmix::fill_range() against the scalar splitmix64 stream;
+//- interleaved<Engine, Depth> against its engines, for the order of their results;
+//- fill_u32() and next_u32() against the 32-bit halves of the stream, high half first for the + engines;
+//- bit_pool<Engine> against the bits of the fill() stream, and next_bernoulli() at 0, 1 and NaN;
+//- split() into narrower engines against the stream of the whole engine, and merge() back with ==;
+//- state_hash() and state_hasher of equal engines, and of an engine after jump();
+//- fill_file() against parallel_fill() with the same seed, on POSIX systems.
+//Prints the failed checks and exits with 1 if there are any, or with 77 (skipped) if the CPU cannot run the build or
+//no temporary directory can be created for fill_file().
+//
+//Usage: test
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if defined __unix__ || defined __APPLE__
+#include <unistd.h>
+#endif
+
+#include "bit_pool.h"
+#include "buffered.h"
+#include "dispatch.h"
+#include "interleaved.h"
+#include "mapped_file.h"
+#include "parallel.h"
+#include "philox.h"
+#include "splitmix.h"
+#include "state.h"
+#include "uniform.h"
+#include "xoroshiro128plus.h"
+#include "xoroshiro128plusplus.h"
+#include "xorshift128plus.h"
+#include "xorshift64.h"
+#include "xoshiro256plusplus.h"
+#include "xoshiro256ss.h"
+
+namespace {
+
+int checks = 0;
+int failures = 0;
+
+void check(uint64_t actual, uint64_t expected, const char* engine, const char* what, size_t index)
+{
+    ++checks;
+    if (actual == expected)
+        return;
+    ++failures;
+    std::fprintf(stderr, "FAIL %s %s [%zu]: 0x%016" PRIx64 ", expected 0x%016" PRIx64 "\n", engine, what, index, actual, expected);
+}
+
+//Exit code that ctest reports as a skipped test (SKIP_RETURN_CODE).
+constexpr int skipped = 77;
+
+//Number of outputs per lane compared in the lane and kernel tests; more than a few bulk loop iterations.
+constexpr size_t steps = 67;
+
+//Scalar engine with the given state words, loaded through a snapshot so that every engine is built the same way.
+template <typename Scalar>
+Scalar scalar_engine(const uint64_t* words)
+{
+    constexpr size_t words_per_lane = (Scalar::state_size - simdrand::state_header_size) / sizeof(uint64_t);
+
+    Scalar engine { splitmix::splitmix64(0) };
+    unsigned char snapshot[Scalar::state_size];
+    engine.save_state(snapshot);
+    for (size_t w = 0; w < words_per_lane; ++w)
+        simdrand::detail::store_le(snapshot + simdrand::state_header_size + w * sizeof(uint64_t), words[w]);
+    engine.load_state(snapshot);
+    return engine;
+}
+
+//Scalar engine with the state of lane i of engine, read from the snapshot of engine.
+template <typename Scalar, typename Engine>
+Scalar lane_engine(const Engine& engine, size_t i)
+{
+    constexpr size_t words_per_lane = (Scalar::state_size - simdrand::state_header_size) / sizeof(uint64_t);
+
+    unsigned char snapshot[Engine::state_size];
+    engine.save_state(snapshot);
+    uint64_t words[words_per_lane];
+    for (size_t w = 0; w < words_per_lane; ++w)
+        words[w] = simdrand::detail::load_le(snapshot + simdrand::state_header_size + (i * words_per_lane + w) * sizeof(uint64_t));
+    return scalar_engine<Scalar>(words);
+}
+
+//Compares the next outputs of engine with the expected values, then runs jump() and long_jump() from the initial
+//state and compares the outputs that follow each.
+template <typename Engine, size_t N, size_t J>
+void known_answers(const Engine& initial, const char* name, const uint64_t (&next)[N], const uint64_t (&jump)[J], const uint64_t (&long_jump)[J])
+{
+    Engine engine = initial;
+    for (size_t i = 0; i < N; ++i)
+        check(engine.next(), next[i], name, "next", i);
+
+    engine = initial;
+    engine.jump();
+    for (size_t i = 0; i < J; ++i)
+        check(engine.next(), jump[i], name, "jump", i);
+
+    engine = initial;
+    engine.long_jump();
+    for (size_t i = 0; i < J; ++i)
+        check(engine.next(), long_jump[i], name, "long_jump", i);
+}
+
+void test_known_answers()
+{
+    //https://prng.di.unimi.it/splitmix64.c from a state of 0.
+    splitmix::splitmix64 splitmix(0);
+    const uint64_t splitmix_next[] = { 0xe220a8397b1dcdaf, 0x6e789e6aa1b965f4, 0x06c45d188009454f, 0xf88bb8a8724c81ec };
+    for (size_t i = 0; i < 4; ++i)
+        check(splitmix.next(), splitmix_next[i], "splitmix64", "next", i);
+
+    //Marsaglia, "Xorshift RNGs", with the (13, 7, 17) shifts and his example seed.
+    xorshift64::xorshift64 xorshift(88172645463325252);
+    const uint64_t xorshift_next[] = { 8748534153485358512U, 3040900993826735515U, 3453997556048239312U, 16431732851926010853U };
+    for (size_t i = 0; i < 4; ++i)
+        check(xorshift.next(), xorshift_next[i], "xorshift64", "next", i);
+
+    //Vigna, "Further scramblings of Marsaglia's xorshift generators", with the (23, 17, 26) shifts. The jump polynomials
+    //advance the state by 2^64 and 2^96 steps.
+    known_answers(xorshift128plus::xorshift128plus(1, 2), "xorshift128plus",
+        { 0x0000000000800045, 0x0000000002000104, 0x00004000020010c3, 0x0000c00002103045 },
+        { 0xe0779a2aa6946409, 0x4a4d4951e8d1cd88 },
+        { 0x44dd64b5f8f4a909, 0xb018371e219931cc });
+
+    //https://prng.di.unimi.it/xoroshiro128plus.c, xoroshiro128plusplus.c, xoshiro256plusplus.c and xoshiro256starstar.c.
+    known_answers(xoroshiro128plus::xoroshiro128plus(1, 2), "xoroshiro128plus",
+        { 0x0000000000000003, 0x0000006001030003, 0x20c102c302000c03, 0x810180670d23ad61 },
+        { 0xea081299d29ad927, 0xdde2899549f899c8 },
+        { 0x6786a13daa9b187d, 0xe6c8f691b4e837bd });
+    known_answers(xoroshiro128plusplus::xoroshiro128plusplus(1, 2), "xoroshiro128plusplus",
+        { 0x0000000000060001, 0x000260c000660007, 0x180acc04718606d3, 0x9e226d35036fc4c7 },
+        { 0x6115ff4c07d8c03e, 0xf4564a51c7eab4b9 },
+        { 0xbb077da55888837c, 0x3fd58ef899113160 });
+    known_answers(xoshiro256plusplus::xoshiro256plusplus(1, 2, 3, 4), "xoshiro256plusplus",
+        { 0x0000000002800001, 0x0000000003800067, 0x000cc00003800067, 0x000cc201994400b2 },
+        { 0xec879073673df437, 0x20d212a39aca1eaa },
+        { 0xb5c4ea370b330bf5, 0x5173cc693c0fa533 });
+    known_answers(xoshiro256ss::xoshiro256ss(1, 2, 3, 4), "xoshiro256ss",
+        { 0x0000000000002d00, 0x0000000000000000, 0x000000005a007080, 0x10e0000000009d80 },
+        { 0xbbd2f312298443d8, 0x62e57db2d5706577 },
+        { 0x527752a1d792704d, 0xd8d8bdec57599e64 });
+
+    //Random123 kat_vectors for philox4x32_10: counter and key all zeros, all ones, and the digits of pi. A block
+    //{x0, x1, x2, x3} is returned as x0 | x1 << 32 and x2 | x3 << 32.
+    philox::philox4x32_10 zeros(0, 0, 0);
+    check(zeros.next(), 0xe169c58d6627e8d5, "philox4x32_10", "zeros", 0);
+    check(zeros.next(), 0x9b00dbd8bc57ac4c, "philox4x32_10", "zeros", 1);
+    philox::philox4x32_10 ones(UINT64_MAX, UINT64_MAX, UINT64_MAX);
+    check(ones.next(), 0x41c83b0e408f276d, "philox4x32_10", "ones", 0);
+    check(ones.next(), 0x6d5451fda20bc7c6, "philox4x32_10", "ones", 1);
+    philox::philox4x32_10 pi(0x299f31d0a4093822, 0x85a308d3243f6a88, 0x0370734413198a2e);
+    check(pi.next(), 0x94fdccebd16cfe09, "philox4x32_10", "pi", 0);
+    check(pi.next(), 0x24126ea15001e420, "philox4x32_10", "pi", 1);
+}
+
+//Compares steps outputs of every lane of engine, which has Width lanes, with the scalar engines of the lanes:
+//output j of lane i is at j * Width + i of the stream. Half of the outputs go through next(), the rest through fill().
+template <size_t Width, typename Engine, typename Scalar>
+void compare_lanes(Engine& engine, std::vector<Scalar>& lanes, const char* name, const char* what)
+{
+    std::vector<uint64_t> stream(steps * Width);
+    for (size_t j = 0; j < steps / 2; ++j) {
+        const auto v = engine.next();
+        std::memcpy(&stream[j * Width], &v, sizeof(v));
+    }
+    engine.fill(&stream[steps / 2 * Width], (steps - steps / 2) * Width);
+
+    for (size_t j = 0; j < steps; ++j)
+        for (size_t i = 0; i < Width; ++i)
+            check(stream[j * Width + i], lanes[i].next(), name, what, j * Width + i);
+}
+
+//Checks every lane of Engine against Scalar for next() and fill(), then again after jump() and long_jump() of the
+//whole engine and of every scalar engine, when HasJump.
+template <typename Engine, typename Scalar, size_t Width, bool HasJump = true>
+struct lane_test {
+    static void run(const char* name)
+    {
+        Engine engine { splitmix::splitmix64(0x5eed) };
+        std::vector<Scalar> lanes;
+        for (size_t i = 0; i < Width; ++i)
+            lanes.push_back(lane_engine<Scalar>(engine, i));
+        compare_lanes<Width>(engine, lanes, name, "next");
+        jumps(engine, lanes, name, std::integral_constant<bool, HasJump>());
+    }
+
+private:
+    static void jumps(Engine& engine, std::vector<Scalar>& lanes, const char* name, std::true_type)
+    {
+        engine.jump();
+        for (Scalar& lane : lanes)
+            lane.jump();
+        compare_lanes<Width>(engine, lanes, name, "jump");
+
+        engine.long_jump();
+        for (Scalar& lane : lanes)
+            lane.long_jump();
+        compare_lanes<Width>(engine, lanes, name, "long_jump");
+    }
+
+    static void jumps(Engine&, std::vector<Scalar>&, const char*, std::false_type)
+    {
+    }
+};
+
+//Engines whose widths all generate one stream, the one of the scalar engine constructed from the same arguments.
+template <typename Engine, typename Scalar, typename... Args>
+void compare_stream(const char* name, Args... args)
+{
+    Engine engine(args...);
+    Scalar scalar(args...);
+    std::vector<uint64_t> stream(steps * 8 + 3);
+    engine.fill(stream.data(), stream.size());
+    for (size_t j = 0; j < stream.size(); ++j)
+        check(stream[j], scalar.next(), name, "stream", j);
+}
+
+void test_lanes()
+{
+#if defined __SSE4_1__ || defined SIMDRAND_NEON
+    compare_stream<splitmix::splitmix64_2, splitmix::splitmix64>("splitmix64_2", uint64_t(0x5eed));
+#endif
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+    lane_test<xorshift64::xorshift64_2, xorshift64::xorshift64, 2, false>::run("xorshift64_2");
+    lane_test<xorshift128plus::xorshift128plus_2, xorshift128plus::xorshift128plus, 2>::run("xorshift128plus_2");
+    lane_test<xoroshiro128plus::xoroshiro128plus_2, xoroshiro128plus::xoroshiro128plus, 2>::run("xoroshiro128plus_2");
+    lane_test<xoroshiro128plusplus::xoroshiro128plusplus_2, xoroshiro128plusplus::xoroshiro128plusplus, 2>::run("xoroshiro128plusplus_2");
+    lane_test<xoshiro256plusplus::xoshiro256plusplus_2, xoshiro256plusplus::xoshiro256plusplus, 2>::run("xoshiro256plusplus_2");
+    lane_test<xoshiro256ss::xoshiro256ss_2, xoshiro256ss::xoshiro256ss, 2>::run("xoshiro256ss_2");
+    compare_stream<philox::philox4x32_10_2, philox::philox4x32_10>("philox4x32_10_2", uint64_t(0x5eed), uint64_t(UINT64_MAX - 5), uint64_t(7));
+#endif
+
+#ifdef __AVX2__
+    compare_stream<splitmix::splitmix64_4, splitmix::splitmix64>("splitmix64_4", uint64_t(0x5eed));
+    lane_test<xorshift64::xorshift64_4, xorshift64::xorshift64, 4, false>::run("xorshift64_4");
+    lane_test<xorshift128plus::xorshift128plus_4, xorshift128plus::xorshift128plus, 4>::run("xorshift128plus_4");
+    lane_test<xoroshiro128plus::xoroshiro128plus_4, xoroshiro128plus::xoroshiro128plus, 4>::run("xoroshiro128plus_4");
+    lane_test<xoroshiro128plusplus::xoroshiro128plusplus_4, xoroshiro128plusplus::xoroshiro128plusplus, 4>::run("xoroshiro128plusplus_4");
+    lane_test<xoshiro256plusplus::xoshiro256plusplus_4, xoshiro256plusplus::xoshiro256plusplus, 4>::run("xoshiro256plusplus_4");
+    lane_test<xoshiro256ss::xoshiro256ss_4, xoshiro256ss::xoshiro256ss, 4>::run("xoshiro256ss_4");
+    compare_stream<philox::philox4x32_10_4, philox::philox4x32_10>("philox4x32_10_4", uint64_t(0x5eed), uint64_t(UINT64_MAX - 5), uint64_t(7));
+#endif
+
+#ifdef __AVX512F__
+    compare_stream<splitmix::splitmix64_8, splitmix::splitmix64>("splitmix64_8", uint64_t(0x5eed));
+    lane_test<xorshift64::xorshift64_8, xorshift64::xorshift64, 8, false>::run("xorshift64_8");
+    lane_test<xorshift128plus::xorshift128plus_8, xorshift128plus::xorshift128plus, 8>::run("xorshift128plus_8");
+    lane_test<xoroshiro128plus::xoroshiro128plus_8, xoroshiro128plus::xoroshiro128plus, 8>::run("xoroshiro128plus_8");
+    lane_test<xoroshiro128plusplus::xoroshiro128plusplus_8, xoroshiro128plusplus::xoroshiro128plusplus, 8>::run("xoroshiro128plusplus_8");
+    lane_test<xoshiro256plusplus::xoshiro256plusplus_8, xoshiro256plusplus::xoshiro256plusplus, 8>::run("xoshiro256plusplus_8");
+    lane_test<xoshiro256ss::xoshiro256ss_8, xoshiro256ss::xoshiro256ss, 8>::run("xoshiro256ss_8");
+    compare_stream<philox::philox4x32_10_8, philox::philox4x32_10>("philox4x32_10_8", uint64_t(0x5eed), uint64_t(UINT64_MAX - 5), uint64_t(7));
+#endif
+}
+
+#if defined __x86_64__ || defined __i386__
+const simdrand::isa levels[] = { simdrand::isa::scalar, simdrand::isa::avx, simdrand::isa::avx2, simdrand::isa::avx512 };
+#elif defined SIMDRAND_NEON
+const simdrand::isa levels[] = { simdrand::isa::scalar, simdrand::isa::neon };
+#else
+const simdrand::isa levels[] = { simdrand::isa::scalar };
+#endif
+
+//Outputs of the dispatch test: a multiple of the 8 lanes, then a tail, then enough for the non-temporal stores.
+constexpr size_t dispatch_small = steps * simdrand::dispatch<xorshift64::kernel>::lanes + 5;
+constexpr size_t dispatch_large = simdrand::non_temporal_threshold / sizeof(uint64_t);
+
+//Output of the dispatch engine over Kernel at level from state, with fill() calls of both sizes.
+template <typename Kernel>
+std::vector<uint64_t> dispatch_stream(const uint64_t (&state)[Kernel::words][simdrand::dispatch<Kernel>::lanes], simdrand::isa level)
+{
+    simdrand::dispatch<Kernel> engine(state, level);
+    //64-byte aligned, so the large fill takes the non-temporal path.
+    std::vector<uint64_t> storage(dispatch_small + dispatch_large + 8);
+    uint64_t* const stream = storage.data() + (8 - reinterpret_cast<uintptr_t>(storage.data()) / sizeof(uint64_t) % 8) % 8;
+    engine.fill(stream, dispatch_small);
+    engine.fill(stream + dispatch_small, dispatch_large);
+    return std::vector<uint64_t>(stream, stream + dispatch_small + dispatch_large);
+}
+
+//Checks the kernels of every level the CPU supports against each other, and the scalar one against the scalar
+//engines of its lanes: with Lanes lanes, output j * Lanes + i comes from lane i.
+template <typename Kernel, typename Scalar>
+void dispatch_test(const char* name)
+{
+    constexpr size_t lanes = simdrand::dispatch<Kernel>::lanes;
+
+    uint64_t state[Kernel::words][lanes];
+    splitmix::splitmix64 gen(0x5eed);
+    for (size_t w = 0; w < Kernel::words; ++w)
+        for (size_t i = 0; i < lanes; ++i)
+            state[w][i] = gen.next();
+
+    const std::vector<uint64_t> reference = dispatch_stream<Kernel>(state, simdrand::isa::scalar);
+    for (size_t i = 0; i < lanes; ++i) {
+        uint64_t words[Kernel::words];
+        for (size_t w = 0; w < Kernel::words; ++w)
+            words[w] = state[w][i];
+        Scalar scalar = scalar_engine<Scalar>(words);
+        for (size_t j = i; j < dispatch_small; j += lanes)
+            check(reference[j], scalar.next(), name, "scalar kernel", j);
+    }
+
+    for (simdrand::isa level : levels) {
+        if (level > simdrand::detected_isa())
+            continue;
+        const std::vector<uint64_t> stream = dispatch_stream<Kernel>(state, level);
+        for (size_t j = 0; j < stream.size(); ++j)
+            check(stream[j], reference[j], name, "kernel", j);
+    }
+}
+
+void test_dispatch()
+{
+    dispatch_test<xorshift64::kernel, xorshift64::xorshift64>("xorshift64::dispatch");
+    dispatch_test<xorshift128plus::kernel, xorshift128plus::xorshift128plus>("xorshift128plus::dispatch");
+    dispatch_test<xoroshiro128plus::kernel, xoroshiro128plus::xoroshiro128plus>("xoroshiro128plus::dispatch");
+    dispatch_test<xoroshiro128plusplus::kernel, xoroshiro128plusplus::xoroshiro128plusplus>("xoroshiro128plusplus::dispatch");
+    dispatch_test<xoshiro256plusplus::kernel, xoshiro256plusplus::xoshiro256plusplus>("xoshiro256plusplus::dispatch");
+    dispatch_test<xoshiro256ss::kernel, xoshiro256ss::xoshiro256ss>("xoshiro256ss::dispatch");
+
+    //The splitmix64 kernel seeds its lanes from one sequence and strides them, so it is checked against that sequence.
+    for (simdrand::isa level : levels) {
+        if (level > simdrand::detected_isa())
+            continue;
+        splitmix::dispatch engine(splitmix::splitmix64(0x5eed), level);
+        splitmix::splitmix64 scalar(0x5eed);
+        std::vector<uint64_t> stream(dispatch_small);
+        engine.fill(stream.data(), stream.size());
+        for (size_t j = 0; j < stream.size(); ++j)
+            check(stream[j], scalar.next(), "splitmix::dispatch", "stream", j);
+    }
+}
+
+//Bits of x, for the bit-exact comparisons of floating-point results.
+template <typename T>
+uint64_t bits(T x)
+{
+    uint64_t b = 0;
+    std::memcpy(&b, &x, sizeof(x));
+    return b;
+}
+
+//Checks fill_uniform() into doubles and floats against the scalar conversions of the stream of a copy of initial:
+//double j is to_double() of output j and float j is to_float() of the j-th 32-bit half, low half first.
+template <typename Engine>
+void uniform_test(const Engine& initial, const char* name)
+{
+    constexpr size_t n = steps * 8 + 3;
+
+    Engine engine = initial;
+    std::vector<uint64_t> stream(n);
+    engine.fill(stream.data(), n);
+
+    engine = initial;
+    std::vector<double> doubles(n);
+    simdrand::fill_uniform(engine, doubles.data(), n);
+    for (size_t j = 0; j < n; ++j)
+        check(bits(doubles[j]), bits(simdrand::to_double(stream[j])), name, "fill_uniform double", j);
+
+    engine = initial;
+    std::vector<float> floats(2 * n - 1);
+    simdrand::fill_uniform(engine, floats.data(), floats.size());
+    for (size_t j = 0; j < floats.size(); ++j) {
+        const uint32_t half = static_cast<uint32_t>(stream[j / 2] >> (j % 2 * 32));
+        check(bits(floats[j]), bits(simdrand::to_float(half)), name, "fill_uniform float", j);
+    }
+}
+
+void test_uniform()
+{
+    uniform_test(xoshiro256plusplus::xoshiro256plusplus(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus");
+    uniform_test(xoroshiro128plus::xoroshiro128plus(splitmix::splitmix64(0x5eed)), "xoroshiro128plus");
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+    uniform_test(xoshiro256plusplus::xoshiro256plusplus_2(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_2");
+    uniform_test(xoroshiro128plus::xoroshiro128plus_2(splitmix::splitmix64(0x5eed)), "xoroshiro128plus_2");
+#endif
+
+#ifdef __AVX2__
+    uniform_test(xoshiro256plusplus::xoshiro256plusplus_4(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_4");
+    uniform_test(xoroshiro128plus::xoroshiro128plus_4(splitmix::splitmix64(0x5eed)), "xoroshiro128plus_4");
+#endif
+
+#ifdef __AVX512F__
+    uniform_test(xoshiro256plusplus::xoshiro256plusplus_8(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_8");
+    uniform_test(xoroshiro128plus::xoroshiro128plus_8(splitmix::splitmix64(0x5eed)), "xoroshiro128plus_8");
+#endif
+}
+
+#ifdef __AVX2__
+
+//Scalar Lemire sampling of candidate x: returns whether x is accepted for range and stores the result in value.
+bool lemire(uint32_t x, uint32_t range, uint64_t& value)
+{
+    const uint64_t product = static_cast<uint64_t>(x) * range;
+    value = product >> 32;
+    return static_cast<uint32_t>(product) >= (0U - range) % range;
+}
+
+bool lemire(uint64_t x, uint64_t range, uint64_t& value)
+{
+    //The 128-bit product from 32-bit parts, so that the reference does not depend on the compiler.
+    const uint64_t x0 = x & 0xffffffff, x1 = x >> 32, r0 = range & 0xffffffff, r1 = range >> 32;
+    const uint64_t low = x0 * r0, cross0 = x0 * r1, cross1 = x1 * r0;
+    const uint64_t middle = (low >> 32) + (cross0 & 0xffffffff) + (cross1 & 0xffffffff);
+    value = x1 * r1 + (cross0 >> 32) + (cross1 >> 32) + (middle >> 32);
+    return ((middle << 32) | (low & 0xffffffff)) >= (0 - range) % range;
+}
+
+template <typename Engine>
+auto next_bounded(Engine& engine, uint32_t range) -> decltype(engine.next())
+{
+    return engine.next_bounded(range);
+}
+
+template <typename Engine>
+auto next_bounded(Engine& engine, uint64_t range) -> decltype(engine.next())
+{
+    return engine.next_bounded64(range);
+}
+
+//Checks fill_bounded() and next_bounded() (next_bounded64() for 64-bit elements) against scalar Lemire sampling of
+//the stream of a copy of initial, whose outputs are split into Element candidates in memory order.
+//fill_bounded() keeps the accepted candidates in order; element h of next_bounded() is the first accepted candidate
+//at h of further next() calls, which leaves the engine after the call that completes the slowest element.
+template <typename Element, typename Engine>
+void bounded_test(const Engine& initial, const char* name, Element range)
+{
+    using vector_type = decltype(std::declval<Engine&>().next());
+    constexpr size_t count = sizeof(vector_type) / sizeof(Element);
+    constexpr size_t n = steps * count + 3;
+    const bool wide = sizeof(Element) == sizeof(uint64_t);
+
+    Engine engine = initial;
+    Engine source = initial;
+    std::vector<Element> values(n);
+    engine.fill_bounded(values.data(), n, range);
+    Element candidates[count];
+    for (size_t j = 0, h = count; j < n; ++h) {
+        if (h == count) {
+            const vector_type v = source.next();
+            std::memcpy(candidates, &v, sizeof(v));
+            h = 0;
+        }
+        uint64_t value;
+        if (lemire(candidates[h], range, value)) {
+            check(values[j], value, name, wide ? "fill_bounded 64" : "fill_bounded 32", j);
+            check(values[j] < range, true, name, wide ? "fill_bounded 64 in range" : "fill_bounded 32 in range", j);
+            ++j;
+        }
+    }
+
+    engine = initial;
+    source = initial;
+    for (size_t r = 0; r < steps; ++r) {
+        const vector_type v = next_bounded(engine, range);
+        Element actual[count];
+        std::memcpy(actual, &v, sizeof(v));
+
+        uint64_t expected[count];
+        unsigned pending = (1U << count) - 1;
+        while (pending != 0) {
+            const vector_type w = source.next();
+            std::memcpy(candidates, &w, sizeof(w));
+            for (size_t h = 0; h < count; ++h)
+                if ((pending >> h & 1) != 0 && lemire(candidates[h], range, expected[h]))
+                    pending &= ~(1U << h);
+        }
+
+        for (size_t h = 0; h < count; ++h) {
+            check(actual[h], expected[h], name, wide ? "next_bounded 64" : "next_bounded 32", r * count + h);
+            check(actual[h] < range, true, name, wide ? "next_bounded 64 in range" : "next_bounded 32 in range", r * count + h);
+        }
+    }
+    check(engine == source, true, name, wide ? "next_bounded 64 state" : "next_bounded 32 state", 0);
+}
+
+//Runs bounded_test() for ranges that are never, rarely and about half of the time rejected, and for the largest range.
+template <typename Engine>
+void bounded_ranges(const Engine& initial, const char* name)
+{
+    for (uint32_t range : { uint32_t(1), uint32_t(6), uint32_t(0x80000001), uint32_t(UINT32_MAX) })
+        bounded_test(initial, name, range);
+    for (uint64_t range : { uint64_t(1), uint64_t(6), uint64_t(0x8000000000000001), uint64_t(UINT64_MAX) })
+        bounded_test(initial, name, range);
+}
+
+#endif // __AVX2__
+
+void test_bounded()
+{
+#ifdef __AVX2__
+    bounded_ranges(xoshiro256plusplus::xoshiro256plusplus_4(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_4");
+    bounded_ranges(xoroshiro128plus::xoroshiro128plus_4(splitmix::splitmix64(0x5eed)), "xoroshiro128plus_4");
+    bounded_ranges(xoshiro256ss::xoshiro256ss_4(splitmix::splitmix64(0x5eed)), "xoshiro256ss_4");
+#endif
+
+#ifdef __AVX512F__
+    bounded_ranges(xoshiro256plusplus::xoshiro256plusplus_8(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_8");
+    bounded_ranges(xoroshiro128plus::xoroshiro128plus_8(splitmix::splitmix64(0x5eed)), "xoroshiro128plus_8");
+    bounded_ranges(xoshiro256ss::xoshiro256ss_8(splitmix::splitmix64(0x5eed)), "xoshiro256ss_8");
+#endif
+}
+
+#ifdef __AVX2__
+
+//Checks that the sample mean and variance of x are within loose bounds of the given mean and stddev; the seeds are
+//fixed, so the bounds (about six standard errors for the sizes used) only have to hold for these samples.
+template <typename T>
+void normal_moments(const std::vector<T>& x, double mean, double stddev, const char* name, const char* what)
+{
+    double sum = 0.0;
+    double squares = 0.0;
+    for (T v : x) {
+        sum += v;
+        squares += static_cast<double>(v) * v;
+    }
+    const double sample_mean = sum / x.size();
+    const double sample_variance = squares / x.size() - sample_mean * sample_mean;
+    check(std::fabs(sample_mean - mean) < 0.02 * stddev, true, name, what, 0);
+    check(std::fabs(sample_variance / (stddev * stddev) - 1.0) < 0.03, true, name, what, 1);
+}
+
+//Checks the moments of fill_normal() and fill_normal_box_muller() from copies of initial, that fill_normal() stores
+//consecutive next_normal() results and that the float versions are rounded from the doubles.
+template <typename Engine>
+void normal_test(const Engine& initial, const char* name)
+{
+    constexpr size_t n = 100003;
+
+    Engine engine = initial;
+    std::vector<double> doubles(n);
+    engine.fill_normal(doubles.data(), n);
+    normal_moments(doubles, 0.0, 1.0, name, "fill_normal double");
+
+    engine = initial;
+    for (size_t j = 0; j < steps * 8; ) {
+        const auto v = engine.next_normal();
+        double lanes[sizeof(v) / sizeof(double)];
+        std::memcpy(lanes, &v, sizeof(v));
+        for (double x : lanes) {
+            check(x == doubles[j], true, name, "next_normal", j);
+            ++j;
+        }
+    }
+
+    engine = initial;
+    std::vector<float> floats(n);
+    engine.fill_normal(floats.data(), n);
+    for (size_t j = 0; j < n; ++j)
+        check(bits(floats[j]), bits(static_cast<float>(doubles[j])), name, "fill_normal float", j);
+
+    engine = initial;
+    std::vector<double> scaled(n);
+    engine.fill_normal(scaled.data(), n, 3.0, 2.0);
+    normal_moments(scaled, 3.0, 2.0, name, "fill_normal scaled");
+
+    engine = initial;
+    engine.fill_normal_box_muller(doubles.data(), n);
+    normal_moments(doubles, 0.0, 1.0, name, "fill_normal_box_muller double");
+
+    engine = initial;
+    engine.fill_normal_box_muller(floats.data(), n);
+    for (size_t j = 0; j < n; ++j)
+        check(bits(floats[j]), bits(static_cast<float>(doubles[j])), name, "fill_normal_box_muller float", j);
+}
+
+#endif // __AVX2__
+
+void test_normal()
+{
+#ifdef __AVX2__
+    normal_test(xoshiro256plusplus::xoshiro256plusplus_4(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_4");
+    normal_test(xoroshiro128plus::xoroshiro128plus_4(splitmix::splitmix64(0x5eed)), "xoroshiro128plus_4");
+#endif
+
+#ifdef __AVX512F__
+    normal_test(xoshiro256plusplus::xoshiro256plusplus_8(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_8");
+    normal_test(xoroshiro128plus::xoroshiro128plus_8(splitmix::splitmix64(0x5eed)), "xoroshiro128plus_8");
+#endif
+}
+
+//Checks that buffered<Engine> returns the stream fill() stores, from operator() and next(), over several refills and a
+//partly used buffer, and leaves the wrapped engine where fill() of the whole refilled buffers does.
+template <typename Engine>
+void buffered_test(const Engine& initial, const char* name)
+{
+    constexpr size_t size = 64;
+    constexpr size_t n = 3 * size + 5;
+
+    simdrand::buffered<Engine, size> engine(initial);
+    Engine reference = initial;
+    std::vector<uint64_t> stream(4 * size);
+    reference.fill(stream.data(), stream.size());
+
+    for (size_t j = 0; j < n; ++j)
+        check(j % 2 == 0 ? engine() : engine.next(), stream[j], name, "buffered", j);
+    check(engine.engine() == reference, true, name, "buffered engine", 0);
+
+    simdrand::buffered<Engine, size> copy = engine;
+    check(copy == engine, true, name, "buffered ==", 0);
+    copy.next();
+    check(copy == engine, false, name, "buffered ==", 1);
+}
+
+void test_buffered()
+{
+    buffered_test(xoshiro256plusplus::dispatch(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus::dispatch");
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+    buffered_test(xoshiro256plusplus::xoshiro256plusplus_2(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_2");
+#endif
+
+#ifdef __AVX2__
+    buffered_test(xoshiro256plusplus::xoshiro256plusplus_4(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_4");
+#endif
+
+#ifdef __AVX512F__
+    buffered_test(xoshiro256plusplus::xoshiro256plusplus_8(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_8");
+#endif
+}
+
+//Checks that parallel_fill() over a few chunks and a partial one gives the same output with 1, 2, 3 and 8 threads,
+//that this output is chunk_engine() of every chunk filled one after another, and that prepare() sees every output once.
+template <typename Engine>
+void parallel_test(const char* name)
+{
+    constexpr size_t n = 3 * simdrand::parallel_chunk + 1001;
+    constexpr uint64_t seed = 0x5eed;
+
+    std::vector<uint64_t> chunks(n);
+    for (size_t c = 0; c * simdrand::parallel_chunk < n; ++c) {
+        const size_t first = c * simdrand::parallel_chunk;
+        simdrand::chunk_engine<Engine>(seed, c).fill(&chunks[first], std::min(simdrand::parallel_chunk, n - first));
+    }
+
+    std::vector<uint64_t> single(n);
+    simdrand::parallel_fill<Engine>(single.data(), n, seed, 1);
+    for (size_t j = 0; j < n; ++j)
+        check(single[j], chunks[j], name, "parallel_fill 1 thread", j);
+
+    for (unsigned threads : { 2U, 3U, 8U }) {
+        std::vector<uint64_t> stream(n);
+        std::atomic<size_t> prepared(0);
+        simdrand::parallel_fill<Engine>(stream.data(), n, seed, threads, [&](uint64_t*, size_t count) noexcept {
+            prepared += count;
+        });
+        for (size_t j = 0; j < n; ++j)
+            check(stream[j], single[j], name, "parallel_fill", threads * n + j);
+        check(prepared, n, name, "parallel_fill prepare", threads);
+    }
+}
+
+void test_parallel()
+{
+    parallel_test<xorshift128plus::dispatch>("xorshift128plus::dispatch");
+    parallel_test<xoshiro256plusplus::dispatch>("xoshiro256plusplus::dispatch");
+}
+
+//Checks splitmix::at() against the scalar splitmix64 stream for every index below 5000, and fill_range() from index 0
+//and from an index that is not a multiple of the lanes of any engine it may use.
+void test_splitmix_range()
+{
+    constexpr uint64_t seed = 0x5eed;
+    constexpr size_t n = 5000;
+
+    splitmix::splitmix64 scalar(seed);
+    std::vector<uint64_t> stream(n);
+    for (size_t i = 0; i < n; ++i) {
+        stream[i] = scalar.next();
+        check(splitmix::at(seed, i), stream[i], "splitmix64", "at", i);
+    }
+
+    for (size_t first : { size_t(0), size_t(1237) }) {
+        std::vector<uint64_t> range(n - first - 3);
+        splitmix::fill_range(seed, first, range.data(), range.size());
+        for (size_t i = 0; i < range.size(); ++i)
+            check(range[i], stream[first + i], "splitmix64", "fill_range", first + i);
+    }
+}
+
+//Checks that next() and fill() of interleaved<Engine, Depth> return result k / Depth of engine k % Depth, starting
+//with a round left unfinished by next(), and that the engines are seeded from consecutive outputs of the splitmix64.
+template <typename Engine, size_t Depth>
+void interleaved_test(const char* name)
+{
+    using result_type = decltype(std::declval<Engine&>().next());
+    constexpr size_t width = sizeof(result_type) / sizeof(uint64_t);
+    constexpr size_t results = steps * Depth + 1;
+
+    simdrand::interleaved<Engine, Depth> engine(splitmix::splitmix64(0x5eed));
+    std::vector<Engine> engines;
+    for (size_t d = 0; d < Depth; ++d) {
+        engines.push_back(Engine(splitmix::splitmix64(splitmix::at(0x5eed, d))));
+        check(engine.engine(d) == engines[d], true, name, "interleaved seed", d);
+    }
+
+    std::vector<uint64_t> stream(results * width);
+    const result_type first = engine.next();
+    std::memcpy(stream.data(), &first, sizeof(first));
+    engine.fill(stream.data() + width, (results - 1) * width);
+
+    for (size_t k = 0; k < results; ++k) {
+        const result_type expected = engines[k % Depth].next();
+        uint64_t words[width];
+        std::memcpy(words, &expected, sizeof(expected));
+        for (size_t i = 0; i < width; ++i)
+            check(stream[k * width + i], words[i], name, "interleaved", k * width + i);
+    }
+    for (size_t d = 0; d < Depth; ++d)
+        check(engine.engine(d) == engines[d], true, name, "interleaved engine", d);
+}
+
+void test_interleaved()
+{
+#if defined __AVX__ || defined SIMDRAND_NEON
+    interleaved_test<xoshiro256plusplus::xoshiro256plusplus_2, 2>("xoshiro256plusplus_2 x2");
+    interleaved_test<xorshift128plus::xorshift128plus_2, 3>("xorshift128plus_2 x3");
+#endif
+
+#ifdef __AVX2__
+    interleaved_test<xoshiro256plusplus::xoshiro256plusplus_4, 2>("xoshiro256plusplus_4 x2");
+    interleaved_test<xorshift128plus::xorshift128plus_4, 3>("xorshift128plus_4 x3");
+#endif
+
+#ifdef __AVX512F__
+    interleaved_test<xoshiro256plusplus::xoshiro256plusplus_8, 2>("xoshiro256plusplus_8 x2");
+    interleaved_test<xorshift128plus::xorshift128plus_8, 3>("xorshift128plus_8 x3");
+#endif
+}
+
+//Compares the consecutive next_u32() results of engine with values.
+template <typename Engine>
+void next_u32_stream(Engine& engine, const std::vector<uint32_t>& values, const char* name, std::true_type)
+{
+    for (size_t j = 0; j + 1 < values.size(); ) {
+        const auto v = simdrand::next_u32(engine);
+        uint32_t halves[sizeof(v) / sizeof(uint32_t)];
+        std::memcpy(halves, &v, sizeof(v));
+        for (size_t h = 0; h < sizeof(v) / sizeof(uint32_t) && j + 1 < values.size(); ++h, ++j)
+            check(halves[h], values[j], name, "next_u32", j);
+    }
+}
+
+//The dispatch engines have no next().
+template <typename Engine>
+void next_u32_stream(Engine&, const std::vector<uint32_t>&, const char*, std::false_type)
+{
+}
+
+//Checks that fill_u32() of a copy of initial stores the 32-bit halves of its fill() stream, the high half of every
+//output first when high_half_first, and that it stores the consecutive next_u32() results when HasNext.
+//The length is odd and more than a chunk of dispatch::fill_u32(), which swaps the halves chunk by chunk.
+template <bool HasNext = true, typename Engine>
+void u32_test(const Engine& initial, const char* name, bool high_half_first)
+{
+    constexpr size_t words = 2503;
+
+    Engine engine = initial;
+    std::vector<uint64_t> stream(words);
+    engine.fill(stream.data(), words);
+
+    engine = initial;
+    std::vector<uint32_t> values(2 * words - 1);
+    engine.fill_u32(values.data(), values.size());
+
+    check(simdrand::detail::high_half_first<Engine>::value, high_half_first, name, "high_half_first", 0);
+    for (size_t j = 0; j < values.size(); ++j) {
+        const bool high = (j % 2 == 0) == high_half_first;
+        check(values[j], static_cast<uint32_t>(stream[j / 2] >> (high ? 32 : 0)), name, "fill_u32", j);
+    }
+
+    engine = initial;
+    next_u32_stream(engine, values, name, std::integral_constant<bool, HasNext>());
+}
+
+void test_u32()
+{
+    u32_test(xorshift128plus::xorshift128plus(splitmix::splitmix64(0x5eed)), "xorshift128plus", true);
+    u32_test(xoroshiro128plus::xoroshiro128plus(splitmix::splitmix64(0x5eed)), "xoroshiro128plus", true);
+    u32_test(xoshiro256plusplus::xoshiro256plusplus(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus", false);
+
+    //buffered splits the outputs of a dispatch engine like its fill_u32() does.
+    xorshift128plus::dispatch engine(splitmix::splitmix64(0x5eed));
+    simdrand::buffered<xorshift128plus::dispatch> buffered(engine);
+    std::vector<uint32_t> expected(2 * steps * 8 - 1), values(expected.size());
+    engine.fill_u32(expected.data(), expected.size());
+    simdrand::fill_u32(buffered, values.data(), values.size());
+    for (size_t j = 0; j < values.size(); ++j)
+        check(values[j], expected[j], "buffered<xorshift128plus::dispatch>", "fill_u32", j);
+
+    for (simdrand::isa level : levels) {
+        u32_test<false>(xorshift128plus::dispatch(splitmix::splitmix64(0x5eed), level), "xorshift128plus::dispatch", true);
+        u32_test<false>(xoroshiro128plus::dispatch(splitmix::splitmix64(0x5eed), level), "xoroshiro128plus::dispatch", true);
+        u32_test<false>(xoshiro256plusplus::dispatch(splitmix::splitmix64(0x5eed), level), "xoshiro256plusplus::dispatch", false);
+    }
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+    u32_test(xorshift128plus::xorshift128plus_2(splitmix::splitmix64(0x5eed)), "xorshift128plus_2", true);
+    u32_test(xoshiro256plusplus::xoshiro256plusplus_2(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_2", false);
+#endif
+
+#ifdef __AVX2__
+    u32_test(xorshift128plus::xorshift128plus_4(splitmix::splitmix64(0x5eed)), "xorshift128plus_4", true);
+    u32_test(xoshiro256plusplus::xoshiro256plusplus_4(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_4", false);
+#endif
+
+#ifdef __AVX512F__
+    u32_test(xorshift128plus::xorshift128plus_8(splitmix::splitmix64(0x5eed)), "xorshift128plus_8", true);
+    u32_test(xoshiro256plusplus::xoshiro256plusplus_8(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_8", false);
+#endif
+}
+
+//Bits first to first + k - 1 of stream, bit i being bit i % 64 of stream[i / 64], with the first in the lowest bit.
+uint64_t stream_bits(const std::vector<uint64_t>& stream, size_t first, unsigned k)
+{
+    uint64_t bits = 0;
+    for (unsigned b = 0; b < k; ++b)
+        bits |= (stream[(first + b) / 64] >> ((first + b) % 64) & 1) << b;
+    return bits;
+}
+
+//Checks that bit_pool<Engine> returns the bits of the fill() stream in order for draws of every size, across word and
+//refill boundaries, and that next_bernoulli() compares 32 of them with the threshold: never true for 0 and NaN,
+//always for 1.
+template <typename Engine>
+void bit_pool_test(const Engine& initial, const char* name)
+{
+    constexpr size_t size = 64;
+
+    simdrand::bit_pool<Engine, size> pool(initial);
+    Engine reference = initial;
+    std::vector<uint64_t> stream(8 * size);
+    reference.fill(stream.data(), stream.size());
+
+    size_t position = 0;
+    for (unsigned k = 1; position + 64 <= 3 * size * 64; k = k % 64 + 1) {
+        check(pool.next_bits(k), stream_bits(stream, position, k), name, "next_bits", position);
+        position += k;
+        check(pool.next_bool(), stream_bits(stream, position, 1), name, "next_bool", position);
+        position += 1;
+        check(pool.next_byte(), stream_bits(stream, position, 8), name, "next_byte", position);
+        position += 8;
+    }
+
+    const double probabilities[] = { 0.0, 1.0, std::nan(""), -1.0, 2.0, 0.5 };
+    for (size_t i = 0; i < 6 * steps; ++i) {
+        const double p = probabilities[i % 6];
+        const uint64_t bits = stream_bits(stream, position, 32);
+        const bool expected = p == 0.5 ? bits < UINT64_C(1) << 31 : p >= 1.0;
+        check(pool.next_bernoulli(p), expected, name, "next_bernoulli", i);
+        position += 32;
+    }
+
+    //The pool refills size outputs at a time, as many times as the bits drawn so far needed.
+    const size_t refills = (position + size * 64 - 1) / (size * 64);
+    check(pool.available(), refills * size * 64 - position, name, "available", 0);
+    reference = initial;
+    for (size_t r = 0; r < refills; ++r)
+        reference.fill(stream.data(), size);
+    check(pool.engine() == reference, true, name, "bit_pool engine", 0);
+}
+
+void test_bit_pool()
+{
+    bit_pool_test(xoshiro256plusplus::xoshiro256plusplus(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus");
+    bit_pool_test(xoshiro256plusplus::dispatch(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus::dispatch");
+
+#ifdef __AVX2__
+    bit_pool_test(xoshiro256plusplus::xoshiro256plusplus_4(splitmix::splitmix64(0x5eed)), "xoshiro256plusplus_4");
+#endif
+}
+
+//Checks that split() of a Whole engine into Part engines continues its stream when the parts are stepped in turn, and
+//that merge() of the stepped parts equals the Whole engine stepped as far.
+template <typename Whole, typename Part, size_t... J>
+void split_test(const char* name, std::index_sequence<J...>)
+{
+    constexpr size_t parts = sizeof...(J);
+    constexpr size_t width = sizeof(std::declval<Whole&>().next()) / sizeof(uint64_t);
+    constexpr size_t lanes = width / parts;
+
+    Whole whole { splitmix::splitmix64(0x5eed) };
+    whole.next();
+    Part pieces[] = { Part(splitmix::splitmix64(J))... };
+    check(simdrand::split(whole, pieces), true, name, "split", 0);
+
+    Whole merged { splitmix::splitmix64(1) };
+    check(simdrand::merge(pieces, merged), true, name, "merge", 0);
+    check(merged == whole, true, name, "split and merge", 0);
+
+    std::vector<uint64_t> stream(steps * width);
+    whole.fill(stream.data(), stream.size());
+    for (size_t k = 0; k < steps * parts; ++k) {
+        const auto v = pieces[k % parts].next();
+        uint64_t words[lanes];
+        std::memcpy(words, &v, sizeof(v));
+        for (size_t i = 0; i < lanes; ++i)
+            check(words[i], stream[k * lanes + i], name, "split stream", k * lanes + i);
+    }
+
+    check(merged == whole, false, name, "split and merge", 1);
+    check(simdrand::merge(pieces, merged), true, name, "merge", 1);
+    check(merged == whole, true, name, "split and merge", 2);
+}
+
+template <typename Whole, typename Part, size_t Parts>
+void split_test(const char* name)
+{
+    split_test<Whole, Part>(name, std::make_index_sequence<Parts>());
+}
+
+void test_split()
+{
+#if defined __AVX__ || defined SIMDRAND_NEON
+    split_test<xoshiro256plusplus::xoshiro256plusplus_2, xoshiro256plusplus::xoshiro256plusplus, 2>("xoshiro256plusplus_2 to scalar");
+#endif
+
+#ifdef __AVX2__
+    split_test<xoshiro256plusplus::xoshiro256plusplus_4, xoshiro256plusplus::xoshiro256plusplus_2, 2>("xoshiro256plusplus_4 to _2");
+    split_test<xoroshiro128plusplus::xoroshiro128plusplus_4, xoroshiro128plusplus::xoroshiro128plusplus, 4>("xoroshiro128plusplus_4 to scalar");
+#endif
+
+#ifdef __AVX512F__
+    split_test<xoshiro256plusplus::xoshiro256plusplus_8, xoshiro256plusplus::xoshiro256plusplus_4, 2>("xoshiro256plusplus_8 to _4");
+    split_test<xoshiro256plusplus::xoshiro256plusplus_8, xoshiro256plusplus::xoshiro256plusplus_2, 4>("xoshiro256plusplus_8 to _2");
+    split_test<xoshiro256plusplus::xoshiro256plusplus_8, xoshiro256plusplus::xoshiro256plusplus, 8>("xoshiro256plusplus_8 to scalar");
+    split_test<xoroshiro128plusplus::xoroshiro128plusplus_8, xoroshiro128plusplus::xoroshiro128plusplus_4, 2>("xoroshiro128plusplus_8 to _4");
+#endif
+}
+
+//Checks that an engine restored from the snapshot of another compares and hashes equal to it, also through
+//state_hasher in an unordered_set, and that jump() makes it compare unequal and changes its hash.
+template <typename Engine>
+void hash_test(const char* name)
+{
+    const Engine engine { splitmix::splitmix64(0x5eed) };
+    Engine copy { splitmix::splitmix64(1) };
+    check(copy == engine, false, name, "==", 0);
+
+    unsigned char snapshot[Engine::state_size];
+    engine.save_state(snapshot);
+    check(copy.load_state(snapshot), true, name, "load_state", 0);
+    check(copy == engine, true, name, "==", 1);
+    check(copy.state_hash(), engine.state_hash(), name, "state_hash", 0);
+
+    std::unordered_set<Engine, simdrand::state_hasher> seen;
+    seen.insert(engine);
+    check(seen.insert(copy).second, false, name, "state_hasher", 0);
+
+    copy.jump();
+    check(copy == engine, false, name, "==", 2);
+    check(copy.state_hash() == engine.state_hash(), false, name, "state_hash", 1);
+    check(seen.insert(copy).second, true, name, "state_hasher", 1);
+}
+
+void test_hash()
+{
+    hash_test<xorshift128plus::xorshift128plus>("xorshift128plus");
+    hash_test<xoshiro256plusplus::xoshiro256plusplus>("xoshiro256plusplus");
+
+#if defined __AVX__ || defined SIMDRAND_NEON
+    hash_test<xorshift128plus::xorshift128plus_2>("xorshift128plus_2");
+    hash_test<xoshiro256plusplus::xoshiro256plusplus_2>("xoshiro256plusplus_2");
+#endif
+
+#ifdef __AVX2__
+    hash_test<xorshift128plus::xorshift128plus_4>("xorshift128plus_4");
+    hash_test<xoshiro256plusplus::xoshiro256plusplus_4>("xoshiro256plusplus_4");
+#endif
+
+#ifdef __AVX512F__
+    hash_test<xorshift128plus::xorshift128plus_8>("xorshift128plus_8");
+    hash_test<xoshiro256plusplus::xoshiro256plusplus_8>("xoshiro256plusplus_8");
+#endif
+}
+
+//Checks that fill_file() writes the leading bytes of the parallel_fill() stream of the same seed, for a size that is
+//not a whole number of outputs, into a file in a new temporary directory. Returns false if the directory cannot be
+//created; fill_file() only exists on POSIX systems, elsewhere there is nothing to check.
+bool test_fill_file()
+{
+#if defined __unix__ || defined __APPLE__
+    constexpr size_t bytes = simdrand::parallel_chunk * sizeof(uint64_t) + 4096 + 5;
+    constexpr uint64_t seed = 0x5eed;
+
+    const char* const tmpdir = std::getenv("TMPDIR");
+    std::string directory = std::string(tmpdir != nullptr && *tmpdir != 0 ? tmpdir : "/tmp") + "/simdrand_test_XXXXXX";
+    if (::mkdtemp(&directory[0]) == nullptr)
+        return false;
+    const std::string path = directory + "/random";
+
+    check(simdrand::fill_file(path.c_str(), bytes, seed, 3), true, "fill_file", "fill_file", 0);
+
+    std::vector<unsigned char> contents(bytes + 1);
+    size_t read = 0;
+    if (std::FILE* file = std::fopen(path.c_str(), "rb")) {
+        read = std::fread(contents.data(), 1, contents.size(), file);
+        std::fclose(file);
+    }
+    ::unlink(path.c_str());
+    ::rmdir(directory.c_str());
+    check(read, bytes, "fill_file", "size", 0);
+
+    std::vector<uint64_t> stream((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    simdrand::parallel_fill(stream.data(), stream.size(), seed, 1);
+    const unsigned char* const expected = reinterpret_cast<const unsigned char*>(stream.data());
+    for (size_t i = 0; i < bytes; ++i)
+        check(contents[i], expected[i], "fill_file", "contents", i);
+#endif
+    return true;
+}
+
+//The CMake build compiles this file once per instruction set level; a level the CPU lacks is skipped rather than run.
+bool cpu_supports_build() noexcept
+{
+#if defined __x86_64__ || defined __i386__
+    __builtin_cpu_init();
+#ifdef __AVX512F__
+    if (!__builtin_cpu_supports("avx512f"))
+        return false;
+#endif
+#ifdef __AVX512VL__
+    if (!__builtin_cpu_supports("avx512vl"))
+        return false;
+#endif
+#ifdef __AVX512DQ__
+    if (!__builtin_cpu_supports("avx512dq"))
+        return false;
+#endif
+#ifdef __AVX2__
+    if (!__builtin_cpu_supports("avx2"))
+        return false;
+#endif
+#ifdef __AVX__
+    if (!__builtin_cpu_supports("avx"))
+        return false;
+#endif
+#endif
+    return true;
+}
+
+}
+
+int main()
+{
+    if (!cpu_supports_build()) {
+        std::printf("the CPU does not support the instruction sets of this build, skipping\n");
+        return skipped;
+    }
+
+    test_known_answers();
+    test_lanes();
+    test_dispatch();
+    test_uniform();
+    test_bounded();
+    test_normal();
+    test_buffered();
+    test_parallel();
+    test_splitmix_range();
+    test_interleaved();
+    test_u32();
+    test_bit_pool();
+    test_split();
+    test_hash();
+    const bool wrote_file = test_fill_file();
+
+    std::printf("%d checks, %d failures\n", checks, failures);
+    if (failures != 0)
+        return 1;
+    if (!wrote_file) {
+        std::printf("cannot create a temporary directory for the fill_file test, skipping\n");
+        return skipped;
+    }
+    return 0;
+}
@@ -0,0 +1,457 @@
+//simdrand-cat: writes the parallel_fill() stream of an engine to standard output or to a file, as the input of statistical
+//test suites (PractRand, TestU01, dieharder...) or as random test data. For a given engine and seed the bytes are the same
+//at every width, thread count and output path, and the same as simdrand::fill_file() writes: --width only picks the kernel.
+//
+//Standard output is fed 1 MiB blocks, generated one at a time into a buffer small enough to stay in the cache. When it
+//is a pipe on Linux the blocks go through vmsplice(), which hands their pages to the pipe instead of copying them: the
+//reader must then copy the data out with read() rather than splice() it on, as the pages are reused. --no-splice falls
+//back to write(). A file given with --output is written the same way on a single thread, and generated in place by
+//fill_file() on more; either way it is synced to disk before simdrand-cat exits. --threads, which defaults to one per
+//hardware thread, only applies to --output: standard output is always written by a single thread.
+//Without --bytes the output is endless and ends without an error when the reader closes the pipe.
+//
+//Usage: simdrand-cat [--engine NAME] [--width 1|2|4|8] [--seed N] [--bytes N[K|M|G|T]] [--output FILE] [--threads N]
+//                    [--no-splice] [--stats] [--list]
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+#include "parallel.h"
+#include "dispatch.h"
+#include "philox.h"
+#include "xoroshiro128plus.h"
+#include "xoroshiro128plusplus.h"
+#include "xorshift128plus.h"
+#include "xorshift64.h"
+#include "xoshiro256plusplus.h"
+#include "xoshiro256ss.h"
+
+namespace {
+
+constexpr uint64_t unlimited = UINT64_MAX;
+
+//Bytes generated and written at a time: a multiple of the page size, and of every step of the engines, that fits in L2.
+constexpr size_t block_size = size_t(1) << 20;
+
+struct options {
+    const char* engine = "xorshift128plus";
+    unsigned width = 0;
+    uint64_t seed = 0;
+    bool has_seed = false;
+    uint64_t bytes = unlimited;
+    const char* output = nullptr;
+    unsigned threads = 0;
+    bool has_threads = false;
+    bool splice = true;
+    bool stats = false;
+    bool list = false;
+};
+
+struct result {
+    uint64_t bytes = 0;
+    const char* kernel = nullptr;
+};
+
+//Dispatched engine running the kernel of Level, or the widest one below it the CPU supports.
+template <typename Kernel, simdrand::isa Level>
+struct at_level : simdrand::dispatch<Kernel> {
+    explicit at_level(splitmix::splitmix64 gen) noexcept
+        : simdrand::dispatch<Kernel>(gen, Level)
+    {
+    }
+};
+
+#ifdef SIMDRAND_NEON
+constexpr simdrand::isa two_lanes = simdrand::isa::neon;
+#else
+constexpr simdrand::isa two_lanes = simdrand::isa::avx;
+#endif
+
+const char* isa_name(simdrand::isa level)
+{
+    switch (level) {
+    case simdrand::isa::neon:
+        return "neon";
+    case simdrand::isa::avx:
+        return "avx";
+    case simdrand::isa::avx2:
+        return "avx2";
+    case simdrand::isa::avx512:
+        return "avx512";
+    default:
+        return "scalar";
+    }
+}
+
+//Kernel a dispatched engine ended up with; the other engines run what the compiler flags gave them.
+template <typename Kernel, simdrand::isa Level>
+const char* kernel_name(const at_level<Kernel, Level>& engine)
+{
+    return isa_name(engine.target());
+}
+
+template <typename Engine>
+const char* kernel_name(const Engine&)
+{
+    return nullptr;
+}
+
+//The parallel_fill() stream of seed, produced piece by piece from the engines of its consecutive chunks.
+template <typename Engine>
+class chunk_stream {
+public:
+    explicit chunk_stream(uint64_t seed)
+        : m_seed(seed)
+        , m_engine(simdrand::chunk_engine<Engine>(seed, 0))
+    {
+    }
+
+    const Engine& engine() const { return m_engine; }
+
+    //Fills dst with the next n outputs. n must be a multiple of the step of the engine, as every piece of a chunk is
+    //generated by a separate fill().
+    void fill(uint64_t* dst, size_t n)
+    {
+        while (n != 0) {
+            if (m_left == 0) {
+                m_engine = simdrand::chunk_engine<Engine>(m_seed, ++m_chunk);
+                m_left = simdrand::parallel_chunk;
+            }
+            const size_t count = n < m_left ? n : m_left;
+            m_engine.fill(dst, count);
+            dst += count;
+            n -= count;
+            m_left -= count;
+        }
+    }
+
+private:
+    uint64_t m_seed;
+    size_t m_chunk = 0;
+    size_t m_left = simdrand::parallel_chunk;
+    Engine m_engine;
+};
+
+//Writes n bytes at data to fd, with vmsplice() if splice is set. Returns false with errno set if fd fails.
+bool write_all(int fd, const unsigned char* data, size_t n, bool splice)
+{
+    while (n != 0) {
+        ssize_t done;
+#ifdef __linux__
+        if (splice) {
+            iovec iov = { const_cast<unsigned char*>(data), n };
+            done = ::vmsplice(fd, &iov, 1, 0);
+        } else
+#endif
+            done = ::write(fd, data, n);
+        if (done < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        data += done;
+        n -= static_cast<size_t>(done);
+    }
+    return true;
+}
+
+//Writes the first opt.bytes bytes of the stream to fd, or the stream until the reader goes away.
+template <typename Engine>
+bool write_stream(int fd, const options& opt, result& res)
+{
+    size_t block = block_size;
+    bool splice = false;
+#ifdef __linux__
+    struct stat st;
+    if (opt.splice && ::fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        //The pipe holds at most its size in pages, so once a whole block of that size has gone in after another block,
+        //every page of the other one has been read and it can be overwritten: two blocks are enough.
+        int size = ::fcntl(fd, F_SETPIPE_SZ, static_cast<int>(block_size));
+        if (size < 0)
+            size = ::fcntl(fd, F_GETPIPE_SZ);
+        splice = size > 0;
+        if (splice)
+            block = static_cast<size_t>(size);
+    }
+#endif
+
+    void* storage;
+    if (::posix_memalign(&storage, static_cast<size_t>(::sysconf(_SC_PAGESIZE)), 2 * block) != 0) {
+        errno = ENOMEM;
+        return false;
+    }
+    unsigned char* const buffers[2] = { static_cast<unsigned char*>(storage), static_cast<unsigned char*>(storage) + block };
+
+    chunk_stream<Engine> stream(opt.seed);
+    res.kernel = kernel_name(stream.engine());
+
+    bool ok = true;
+    for (size_t i = 0; res.bytes < opt.bytes; i ^= 1) {
+        const size_t n = opt.bytes - res.bytes < block ? static_cast<size_t>(opt.bytes - res.bytes) : block;
+        stream.fill(reinterpret_cast<uint64_t*>(buffers[i]), block / sizeof(uint64_t));
+        if (!write_all(fd, buffers[i], n, splice)) {
+            //A reader that stops early, like head -c, is a normal end of the stream.
+            ok = errno == EPIPE;
+            break;
+        }
+        res.bytes += n;
+    }
+
+    std::free(storage);
+    return ok;
+}
+
+template <typename Engine>
+bool run(const options& opt, result& res)
+{
+    if (opt.output == nullptr)
+        return write_stream<Engine>(STDOUT_FILENO, opt, res);
+
+    //On a single thread, copying blocks from the cache with write() beats faulting in the pages of a mapping; with more,
+    //fill_file() generates and faults in the chunks of the file in parallel.
+    const unsigned threads = opt.threads != 0 ? opt.threads : std::max(1U, std::thread::hardware_concurrency());
+    if (threads == 1) {
+        const int fd = ::open(opt.output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            return false;
+        const bool ok = write_stream<Engine>(fd, opt, res) && ::fsync(fd) == 0;
+        return ::close(fd) == 0 && ok;
+    }
+
+    res.kernel = kernel_name(simdrand::chunk_engine<Engine>(opt.seed, 0));
+    if (!simdrand::fill_file<Engine>(opt.output, static_cast<size_t>(opt.bytes), opt.seed, threads))
+        return false;
+    res.bytes = opt.bytes;
+    return true;
+}
+
+using runner = bool (*)(const options&, result&);
+
+//The runners of an engine for widths 1, 2, 4 and 8, null for the widths the compiler flags leave out.
+struct engine_entry {
+    const char* name;
+    runner widths[4];
+};
+
+template <typename Kernel>
+constexpr engine_entry dispatched(const char* name)
+{
+    return { name,
+        { run<at_level<Kernel, simdrand::isa::scalar>>, run<at_level<Kernel, two_lanes>>,
+            run<at_level<Kernel, simdrand::isa::avx2>>, run<at_level<Kernel, simdrand::isa::avx512>> } };
+}
+
+const engine_entry engines[] = {
+    dispatched<splitmix::kernel>("splitmix64"),
+    dispatched<xorshift64::kernel>("xorshift64"),
+    dispatched<xorshift128plus::kernel>("xorshift128plus"),
+    dispatched<xoroshiro128plus::kernel>("xoroshiro128plus"),
+    dispatched<xoroshiro128plusplus::kernel>("xoroshiro128plusplus"),
+    dispatched<xoshiro256plusplus::kernel>("xoshiro256plusplus"),
+    dispatched<xoshiro256ss::kernel>("xoshiro256ss"),
+    { "philox4x32_10",
+        { run<philox::philox4x32_10>,
+#if defined __AVX__ || defined SIMDRAND_NEON
+            run<philox::philox4x32_10_2>,
+#else
+            nullptr,
+#endif
+#ifdef __AVX2__
+            run<philox::philox4x32_10_4>,
+#else
+            nullptr,
+#endif
+#ifdef __AVX512F__
+            run<philox::philox4x32_10_8>,
+#else
+            nullptr,
+#endif
+        } },
+};
+
+//Index of width in engine_entry::widths, -1 if it is not one of 1, 2, 4 and 8.
+int width_index(unsigned width)
+{
+    switch (width) {
+    case 1:
+        return 0;
+    case 2:
+        return 1;
+    case 4:
+        return 2;
+    case 8:
+        return 3;
+    default:
+        return -1;
+    }
+}
+
+//Default width: the widest the CPU runs for the dispatched engines, the widest compiled in for the others.
+unsigned default_width(const engine_entry& entry)
+{
+    for (unsigned width = 8; width > 1; width /= 2)
+        if (entry.widths[width_index(width)] != nullptr)
+            return width;
+    return 1;
+}
+
+//Parses a byte count with an optional binary K, M, G or T suffix.
+bool parse_size(const char* text, uint64_t& size)
+{
+    char* end;
+    errno = 0;
+    size = std::strtoull(text, &end, 10);
+    if (end == text || errno != 0 || *text == '-')
+        return false;
+
+    unsigned shift = 0;
+    switch (*end) {
+    case 'K':
+        shift = 10;
+        break;
+    case 'M':
+        shift = 20;
+        break;
+    case 'G':
+        shift = 30;
+        break;
+    case 'T':
+        shift = 40;
+        break;
+    case '\0':
+        return true;
+    default:
+        return false;
+    }
+    if (end[1] != '\0' || size > UINT64_MAX >> shift)
+        return false;
+    size <<= shift;
+    return true;
+}
+
+bool parse(int argc, char** argv, options& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        const bool has_value = i + 1 < argc;
+        if (std::strcmp(argv[i], "--engine") == 0 && has_value)
+            opt.engine = argv[++i];
+        else if (std::strcmp(argv[i], "--width") == 0 && has_value) {
+            opt.width = static_cast<unsigned>(std::atoi(argv[++i]));
+            if (width_index(opt.width) < 0)
+                return false;
+        } else if (std::strcmp(argv[i], "--seed") == 0 && has_value) {
+            //strtoull() would take -1 as 2^64 - 1, so a sign is rejected as in parse_size().
+            char* end;
+            errno = 0;
+            opt.seed = std::strtoull(argv[++i], &end, 0);
+            opt.has_seed = *argv[i] != '\0' && *argv[i] != '-' && *end == '\0' && errno == 0;
+            if (!opt.has_seed)
+                return false;
+        } else if (std::strcmp(argv[i], "--bytes") == 0 && has_value) {
+            if (!parse_size(argv[++i], opt.bytes))
+                return false;
+        } else if (std::strcmp(argv[i], "--output") == 0 && has_value)
+            opt.output = argv[++i];
+        else if (std::strcmp(argv[i], "--threads") == 0 && has_value) {
+            opt.threads = static_cast<unsigned>(std::max(0, std::atoi(argv[++i])));
+            opt.has_threads = true;
+        }
+        else if (std::strcmp(argv[i], "--no-splice") == 0)
+            opt.splice = false;
+        else if (std::strcmp(argv[i], "--stats") == 0)
+            opt.stats = true;
+        else if (std::strcmp(argv[i], "--list") == 0)
+            opt.list = true;
+        else
+            return false;
+    }
+    return true;
+}
+
+void list()
+{
+    for (const engine_entry& entry : engines) {
+        std::printf("%s", entry.name);
+        for (unsigned width = 1; width <= 8; width *= 2)
+            if (entry.widths[width_index(width)] != nullptr)
+                std::printf(" %u", width);
+        std::printf("\n");
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    options opt;
+    if (!parse(argc, argv, opt)) {
+        std::fprintf(stderr,
+            "usage: %s [--engine NAME] [--width 1|2|4|8] [--seed N] [--bytes N[K|M|G|T]] [--output FILE] [--threads N]\n"
+            "       [--no-splice] [--stats] [--list]\n",
+            argv[0]);
+        return 2;
+    }
+    if (opt.list) {
+        list();
+        return 0;
+    }
+
+    const engine_entry* entry = nullptr;
+    for (const engine_entry& candidate : engines)
+        if (std::strcmp(candidate.name, opt.engine) == 0)
+            entry = &candidate;
+    if (entry == nullptr) {
+        std::fprintf(stderr, "%s: unknown engine %s, see --list\n", argv[0], opt.engine);
+        return 2;
+    }
+
+    const unsigned width = opt.width != 0 ? opt.width : default_width(*entry);
+    const runner run_engine = entry->widths[width_index(width)];
+    if (run_engine == nullptr) {
+        std::fprintf(stderr, "%s: %s is not built for width %u, see --list\n", argv[0], entry->name, width);
+        return 2;
+    }
+    if (opt.output != nullptr && opt.bytes == unlimited) {
+        std::fprintf(stderr, "%s: --output needs --bytes\n", argv[0]);
+        return 2;
+    }
+    if (opt.has_threads && opt.output == nullptr) {
+        std::fprintf(stderr, "%s: --threads needs --output, standard output is written by one thread\n", argv[0]);
+        return 2;
+    }
+
+    if (!opt.has_seed) {
+        std::random_device device;
+        opt.seed = uint64_t(device()) << 32 | device();
+    }
+
+    //Write errors are reported through errno instead.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    result res;
+    const auto start = std::chrono::steady_clock::now();
+    const bool ok = run_engine(opt, res);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (!ok)
+        std::fprintf(stderr, "%s: %s: %s\n", argv[0], opt.output != nullptr ? opt.output : "standard output", std::strerror(errno));
+    if (opt.stats)
+        std::fprintf(stderr, "%s width %u (%s), seed %llu: %llu bytes in %.3f s, %.2f GB/s\n", entry->name, width,
+            res.kernel != nullptr ? res.kernel : "compiled", static_cast<unsigned long long>(opt.seed),
+            static_cast<unsigned long long>(res.bytes), seconds, seconds > 0 ? res.bytes / seconds * 1e-9 : 0.0);
+    return ok ? 0 : 1;
+}